@@ -0,0 +1,314 @@
+/*
+ * Copyright Johannes Sixt
+ * This file is licensed under the GNU General Public License Version 2.
+ * See the file COPYING in the toplevel directory of the source directory.
+ */
+
+/*
+ * A stand-in for gdb that answers commands with canned output from a
+ * scenario file, so that the command queue of the driver can be exercised
+ * without a real debugger and program.
+ *
+ * Usage: kdbg-fakegdb scenario [gdb arguments are ignored]
+ *
+ * The scenario file consists of settings and rules:
+ *
+ *   # a comment
+ *   banner GNU gdb (GDB) 12.1	the first line that is printed
+ *   delay 2			ms before the output of a command
+ *   chunk 512			the output is written in pieces of this size
+ *   jitter 3			up to this many ms more before each piece
+ *   seed 1			of the random numbers for the jitter
+ *
+ *   match ^bt$			a regular expression (ECMAScript)
+ *   delay 20			settings after match apply to the rule only
+ *   output
+ *   #0  main () at hello.c:5
+ *   end
+ *
+ * The output of the first rule whose expression is found in the command
+ * is printed, followed by the prompt. A rule may have several outputs;
+ * they are used in turn, and the last one repeats. Backslash escapes like
+ * \n, \t and \032 are replaced in output lines. Commands that no rule
+ * matches produce no output.
+ *
+ * set prompt, define ... end and echo are handled like gdb does. When
+ * SIGINT arrives, the output of the current command is cut off and
+ * "Quit" is printed.
+ */
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <regex>
+#include <string>
+#include <vector>
+
+struct Timing
+{
+    int delay = 0;
+    int chunk = 0;			/* 0: all at once */
+    int jitter = 0;
+};
+
+struct Rule
+{
+    std::regex pattern;
+    Timing timing;
+    std::vector<std::string> outputs;
+    size_t next = 0;
+};
+
+static volatile sig_atomic_t interrupted = 0;
+static std::mt19937 rng;
+
+static void onSigint(int)
+{
+    interrupted = 1;
+}
+
+static std::string unescape(const std::string& s)
+{
+    std::string result;
+    for (size_t i = 0; i < s.size(); i++)
+    {
+	if (s[i] != '\\' || i+1 == s.size()) {
+	    result += s[i];
+	    continue;
+	}
+	char c = s[++i];
+	switch (c) {
+	case 'n': result += '\n'; break;
+	case 't': result += '\t'; break;
+	case 'e': result += '\033'; break;
+	default:
+	    if (c >= '0' && c <= '7') {
+		int v = 0;
+		for (int n = 0; n < 3 && i < s.size() && s[i] >= '0' && s[i] <= '7'; n++)
+		    v = v * 8 + (s[i++] - '0');
+		i--;
+		result += char(v);
+	    } else {
+		result += c;
+	    }
+	}
+    }
+    return result;
+}
+
+static bool readScenario(const char* fileName, std::string& banner,
+			 Timing& defaults, std::vector<Rule>& rules)
+{
+    std::ifstream in(fileName);
+    if (!in) {
+	fprintf(stderr, "cannot open %s\n", fileName);
+	return false;
+    }
+    std::string line;
+    Timing* timing = &defaults;
+    std::string* output = 0;
+    int lineNo = 0;
+    while (std::getline(in, line))
+    {
+	lineNo++;
+	if (output != 0) {
+	    if (line == "end")
+		output = 0;
+	    else
+		*output += unescape(line) + '\n';
+	    continue;
+	}
+	if (line.empty() || line[0] == '#')
+	    continue;
+
+	std::string key = line.substr(0, line.find(' '));
+	std::string arg = key.size() < line.size() ? line.substr(key.size()+1) : std::string();
+	if (key == "banner") {
+	    banner = arg + '\n';
+	} else if (key == "delay") {
+	    timing->delay = atoi(arg.c_str());
+	} else if (key == "chunk") {
+	    timing->chunk = atoi(arg.c_str());
+	} else if (key == "jitter") {
+	    timing->jitter = atoi(arg.c_str());
+	} else if (key == "seed") {
+	    rng.seed(atoi(arg.c_str()));
+	} else if (key == "match") {
+	    Rule r;
+	    try {
+		r.pattern = std::regex(arg);
+	    } catch (const std::regex_error&) {
+		fprintf(stderr, "%s:%d: bad expression\n", fileName, lineNo);
+		return false;
+	    }
+	    r.timing = defaults;
+	    rules.push_back(r);
+	    timing = &rules.back().timing;
+	} else if (key == "output" && !rules.empty()) {
+	    rules.back().outputs.push_back(std::string());
+	    output = &rules.back().outputs.back();
+	} else {
+	    fprintf(stderr, "%s:%d: unknown line\n", fileName, lineNo);
+	    return false;
+	}
+    }
+    return true;
+}
+
+static void writeAll(const char* data, size_t len)
+{
+    while (len > 0) {
+	ssize_t n = write(1, data, len);
+	if (n < 0) {
+	    if (errno == EINTR)
+		continue;
+	    exit(1);
+	}
+	data += n;
+	len -= n;
+    }
+}
+
+/*
+ * Waits; returns false if SIGINT arrived in the meantime.
+ */
+static bool sleepMs(int ms)
+{
+    struct timespec ts = { ms / 1000, (ms % 1000) * 1000000L };
+    while (nanosleep(&ts, &ts) < 0 && errno == EINTR) {
+	if (interrupted)
+	    break;
+    }
+    return !interrupted;
+}
+
+/*
+ * Writes the output of a command like the timing says; returns false if
+ * it was interrupted.
+ */
+static bool emit(const std::string& out, const Timing& t)
+{
+    if (t.delay > 0 && !sleepMs(t.delay))
+	return false;
+    size_t chunk = t.chunk > 0 ? t.chunk : out.size();
+    for (size_t pos = 0; pos < out.size(); pos += chunk)
+    {
+	if (t.jitter > 0 && !sleepMs(std::uniform_int_distribution<int>(0, t.jitter)(rng)))
+	    return false;
+	if (interrupted)
+	    return false;
+	writeAll(out.data() + pos, std::min(chunk, out.size() - pos));
+    }
+    return true;
+}
+
+/*
+ * Reads a line from stdin. Returns 0 at the end of the input, -1 if
+ * SIGINT arrived.
+ */
+static int readLine(std::string& line)
+{
+    static std::string buffer;
+    for (;;) {
+	size_t nl = buffer.find('\n');
+	if (nl != std::string::npos) {
+	    line = buffer.substr(0, nl);
+	    buffer.erase(0, nl+1);
+	    return 1;
+	}
+	char data[4096];
+	ssize_t n = read(0, data, sizeof(data));
+	if (n < 0 && errno == EINTR && interrupted)
+	    return -1;
+	if (n < 0 && errno == EINTR)
+	    continue;
+	if (n <= 0)
+	    return 0;
+	buffer.append(data, n);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+	fprintf(stderr, "usage: kdbg-fakegdb scenario\n");
+	return 2;
+    }
+
+    std::string banner = "GNU gdb (fake) 12.1\n";
+    Timing defaults;
+    std::vector<Rule> rules;
+    if (!readScenario(argv[1], banner, defaults, rules))
+	return 1;
+
+    // system calls must be interrupted by SIGINT
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = onSigint;
+    sigaction(SIGINT, &sa, 0);
+
+    std::string prompt = "(gdb) ";
+    writeAll(banner.data(), banner.size());
+    writeAll(prompt.data(), prompt.size());
+
+    bool inDefine = false;
+    std::string line;
+    for (;;)
+    {
+	int r = readLine(line);
+	if (r == 0)
+	    break;
+	if (r < 0) {
+	    interrupted = 0;
+	    std::string quit = "Quit\n" + prompt;
+	    writeAll(quit.data(), quit.size());
+	    continue;
+	}
+
+	// the commands of a definition are not executed
+	if (inDefine) {
+	    if (line == "end") {
+		inDefine = false;
+		writeAll(prompt.data(), prompt.size());
+	    }
+	    continue;
+	}
+
+	bool ok = true;
+	if (line.compare(0, 11, "set prompt ") == 0) {
+	    prompt = line.substr(11);
+	} else if (line.compare(0, 7, "define ") == 0) {
+	    inDefine = true;
+	    continue;
+	} else if (line.compare(0, 5, "echo ") == 0) {
+	    ok = emit(unescape(line.substr(5)), Timing());
+	} else if (line == "quit") {
+	    break;
+	} else {
+	    for (size_t i = 0; i < rules.size(); i++)
+	    {
+		Rule& rule = rules[i];
+		if (!std::regex_search(line, rule.pattern))
+		    continue;
+		if (!rule.outputs.empty()) {
+		    ok = emit(rule.outputs[rule.next], rule.timing);
+		    if (rule.next + 1 < rule.outputs.size())
+			rule.next++;
+		}
+		break;
+	    }
+	}
+	if (!ok) {
+	    interrupted = 0;
+	    writeAll("Quit\n", 5);
+	}
+	writeAll(prompt.data(), prompt.size());
+    }
+    return 0;
+}
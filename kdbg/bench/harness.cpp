@@ -0,0 +1,227 @@
+/*
+ * Copyright Johannes Sixt
+ * This file is licensed under the GNU General Public License Version 2.
+ * See the file COPYING in the toplevel directory of the source directory.
+ */
+
+/*
+ * Drives the debugger without the main window through a list of actions
+ * and reports how long each action took until the views were up to date
+ * and how many commands it needed. Use it with kdbg-fakegdb to get
+ * repeatable numbers without a real debugger:
+ *
+ *   kdbg-harness [-p depth] [-s] [-j file.json] "kdbg-fakegdb scenario" \
+ *	executable action...
+ *
+ * -s lists the local variables without the members of structs.
+ *
+ * The actions are:
+ *
+ *   run, cont, step, next, stepi, nexti, finish
+ *   expand:NAME	expands a local variable; NAME may be a.b.c
+ *   watch:EXPR		adds a watch expression
+ *
+ * Normally, an action waits until the previous one has completed. An
+ * action prefixed with ! is started right away, e.g. "!expand:v step"
+ * steps while the expansion is still in progress, which interrupts the
+ * low-priority commands.
+ */
+
+#include "debugger.h"
+#include "gdbdriver.h"
+#include "exprwnd.h"
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QJsonDocument>
+#include <QListWidget>
+#include <QStandardPaths>
+#include <QStringList>
+#include <stdio.h>
+
+// an action that does not complete in this time is abandoned
+static const int actionTimeout = 30000;
+
+struct Totals
+{
+    int commands = 0;
+    int fromCache = 0;
+    qint64 bytes = 0;
+};
+
+static Totals totals(const PerfStats& perf)
+{
+    Totals t;
+    const std::vector<CmdPerf>& cmds = perf.commands();
+    for (std::vector<CmdPerf>::const_iterator c = cmds.begin(); c != cmds.end(); ++c) {
+	t.commands += c->debugger.count;
+	t.fromCache += c->fromCache;
+	t.bytes += c->bytes;
+    }
+    return t;
+}
+
+/*
+ * Runs the event loop until the debugger has nothing more to do. If
+ * \a stop is true, the program must also have stopped again (or
+ * terminated).
+ */
+static bool waitIdle(KDebugger& debugger, int stopsBefore, bool stop)
+{
+    QEventLoop loop;
+    QElapsedTimer elapsed;
+    elapsed.start();
+    for (;;) {
+	loop.processEvents(QEventLoop::WaitForMoreEvents, 5);
+	DebuggerDriver* d = debugger.driver();
+	if (d == 0)
+	    return false;
+	bool stopped = !stop ||
+		       !debugger.isProgramActive() ||
+		       d->perfStats().stopCommands().count > stopsBefore;
+	if (stopped && d->isIdle() && !debugger.isProgramRunning() &&
+	    d->commandsInFlight() == 0)
+	    return true;
+	if (elapsed.elapsed() > actionTimeout)
+	    return false;
+    }
+}
+
+static VarTree* findVariable(ExprWnd& wnd, const QString& path)
+{
+    QStringList names = path.split('.');
+    VarTree* v = wnd.topLevelExprByName(names.takeFirst());
+    while (v != 0 && !names.isEmpty())
+	v = ExprWnd::memberByName(v, names.takeFirst());
+    return v;
+}
+
+int main(int argc, char** argv)
+{
+    if (qgetenv("QT_QPA_PLATFORM").isEmpty())
+	qputenv("QT_QPA_PLATFORM", "offscreen");
+    QApplication app(argc, argv);
+    // keep the per-program settings away from those of the user
+    QStandardPaths::setTestModeEnabled(true);
+
+    QStringList args = app.arguments();
+    args.removeFirst();
+    int depth = 1;
+    QString jsonFile;
+    bool shallow = false;
+    while (args.size() >= 2 && args[0].startsWith('-')) {
+	if (args[0] == "-s") {
+	    shallow = true;
+	    args.removeFirst();
+	    continue;
+	}
+	if (args[0] == "-p")
+	    depth = args[1].toInt();
+	else if (args[0] == "-j")
+	    jsonFile = args[1];
+	else
+	    break;
+	args.erase(args.begin(), args.begin()+2);
+    }
+    if (args.size() < 2) {
+	fprintf(stderr, "usage: kdbg-harness [-p depth] [-s] [-j file.json] "
+		"debugger-command executable action...\n");
+	return 2;
+    }
+    QString debuggerCmd = args.takeFirst();
+    QString executable = args.takeFirst();
+
+    QWidget top;
+    ExprWnd locals(&top, "Variable");
+    ExprWnd watches(&top, "Expression");
+    QListWidget backtrace(&top);
+    KDebugger debugger(&top, &locals, &watches, &backtrace);
+
+    GdbDriver* driver = new GdbDriver;
+    driver->setDefaultInvocation(debuggerCmd);
+    driver->setPipelineDepth(depth);
+    driver->setShallowLocals(shallow);
+    if (!debugger.debugProgram(executable, driver)) {
+	delete driver;
+	fprintf(stderr, "cannot start %s\n", qPrintable(debuggerCmd));
+	return 1;
+    }
+    if (!waitIdle(debugger, 0, false)) {
+	fprintf(stderr, "the debugger did not start\n");
+	return 1;
+    }
+
+    printf("%-24s %10s %9s %8s %10s\n", "action", "ms", "commands", "cached", "bytes");
+    int failed = 0;
+    QElapsedTimer timer;
+    for (QStringList::iterator a = args.begin(); a != args.end(); ++a)
+    {
+	QString action = *a;
+	bool wait = !action.startsWith('!');
+	if (!wait)
+	    action.remove(0, 1);
+
+	PerfStats& perf = debugger.driver()->perfStats();
+	Totals before = totals(perf);
+	int stopsBefore = perf.stopCommands().count;
+	bool stop = true;
+	timer.start();
+
+	if (action == "run")
+	    debugger.programRun();
+	else if (action == "cont")
+	    debugger.programRun();
+	else if (action == "step")
+	    debugger.programStep();
+	else if (action == "next")
+	    debugger.programNext();
+	else if (action == "stepi")
+	    debugger.programStepi();
+	else if (action == "nexti")
+	    debugger.programNexti();
+	else if (action == "finish")
+	    debugger.programFinish();
+	else if (action.startsWith("expand:")) {
+	    stop = false;
+	    VarTree* v = findVariable(locals, action.mid(7));
+	    if (v == 0) {
+		fprintf(stderr, "%s: no such variable\n", qPrintable(action));
+		failed++;
+		continue;
+	    }
+	    v->setExpanded(true);
+	} else if (action.startsWith("watch:")) {
+	    stop = false;
+	    debugger.addWatch(action.mid(6));
+	} else {
+	    fprintf(stderr, "%s: unknown action\n", qPrintable(action));
+	    return 2;
+	}
+	if (!wait)
+	    continue;
+
+	if (!waitIdle(debugger, stopsBefore, stop)) {
+	    fprintf(stderr, "%s: timed out\n", qPrintable(action));
+	    failed++;
+	}
+	qint64 ms = timer.elapsed();
+	Totals after = totals(debugger.driver()->perfStats());
+	printf("%-24s %10lld %9d %8d %10lld\n", qPrintable(*a), ms,
+	       after.commands - before.commands,
+	       after.fromCache - before.fromCache,
+	       after.bytes - before.bytes);
+    }
+
+    PerfStats& perf = debugger.driver()->perfStats();
+    printf("stops: %d, on average %.1f ms and %.1f commands\n",
+	   perf.stopTime().count, perf.stopTime().average() / 1000.0,
+	   perf.stopCommands().count == 0 ? 0.0 :
+		double(perf.stopCommands().total) / perf.stopCommands().count);
+    if (!jsonFile.isEmpty()) {
+	QFile f(jsonFile);
+	if (f.open(QIODevice::WriteOnly))
+	    f.write(QJsonDocument(perf.toJson()).toJson());
+    }
+    return failed == 0 ? 0 : 1;
+}
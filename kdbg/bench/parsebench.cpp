@@ -0,0 +1,318 @@
+/*
+ * Copyright Johannes Sixt
+ * This file is licensed under the GNU General Public License Version 2.
+ * See the file COPYING in the toplevel directory of the source directory.
+ */
+
+/*
+ * Replays the output that is recorded in transcripts (kdbg -t) through the
+ * parsers of the gdb driver and reports how fast they are.
+ *
+ * Usage: kdbg-parsebench [-n iterations] transcript...
+ *
+ * The commands of a transcript are matched with the output that gdb
+ * printed up to the next prompt. The initialization of gdb is skipped, as
+ * are commands whose output is not parsed into data structures.
+ */
+
+#include "gdbdriver.h"
+#include "exprwnd.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QStringList>
+#include <map>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define PROMPT "(kdbg)"
+#define PROMPT_LEN 6
+
+
+/*
+ * All allocations are counted so that the allocations per command can be
+ * reported.
+ */
+static long allocCount = 0;
+
+void* operator new(size_t size)
+{
+    allocCount++;
+    void* p = malloc(size == 0 ? 1 : size);
+    if (p == 0)
+	throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+
+enum Parser {
+    Pnone, Plocals, Pprint, PqcharArray, PwcharArray, Pbt, Pbreak,
+    Pthreads, Pregisters, Pdisassemble, Pmemory
+};
+
+static const char* const parserNames[] = {
+    "", "parseLocals", "parsePrintExpr", "parseQCharArray", "parseQCharArray(wchar)",
+    "parseBackTrace", "parseBreakList", "parseThreadList", "parseRegisters",
+    "parseDisassemble", "parseMemoryDump"
+};
+
+struct Sample
+{
+    Parser parser;
+    QByteArray output;
+};
+
+struct Result
+{
+    long count = 0;
+    qint64 bytes = 0;
+    qint64 nsecs = 0;
+    long nodes = 0;
+    long allocs = 0;
+};
+
+static Parser parserFor(const QByteArray& cmd)
+{
+    if (cmd.startsWith("kdbg__alllocals") ||
+	cmd.startsWith("kdbg__shallowlocals"))
+	return Plocals;
+    if (cmd.startsWith("bt "))
+	return Pbt;
+    if (cmd.startsWith("info breakpoints"))
+	return Pbreak;
+    if (cmd.startsWith("info threads"))
+	return Pthreads;
+    if (cmd.startsWith("info all-registers"))
+	return Pregisters;
+    if (cmd.startsWith("disassemble"))
+	return Pdisassemble;
+    if (cmd.startsWith("x "))
+	return Pmemory;
+    if (cmd.startsWith("print ($s="))
+	return PwcharArray;
+    // the QString commands of the type tables
+    if (cmd.startsWith("print ($qstrunicode") || cmd.startsWith("print *(unsigned short*)"))
+	return PqcharArray;
+    if (cmd.startsWith("print "))
+	return Pprint;
+    return Pnone;
+}
+
+/*
+ * Splits a transcript into its records and pairs every command line with
+ * the output up to the prompt that follows it.
+ */
+static bool readTranscript(const QString& fileName, std::list<Sample>& samples)
+{
+    QFile f(fileName);
+    if (!f.open(QIODevice::ReadOnly)) {
+	fprintf(stderr, "cannot open %s\n", qPrintable(fileName));
+	return false;
+    }
+
+    QList<QByteArray> commands;
+    QByteArray output;
+    char kind = 0;
+    bool initialized = false;
+    while (!f.atEnd())
+    {
+	QByteArray line = f.readLine();
+	if (line.startsWith("#### ")) {
+	    QByteArray header = line.trimmed();
+	    kind = header.isEmpty() ? 0 : header[header.size()-1];
+	    // the first record initializes gdb; it has no prompts of its own
+	    if (kind == '>' && !output.isEmpty())
+		initialized = true;
+	    continue;
+	}
+	if (kind == '>') {
+	    if (initialized) {
+		QByteArray cmd = line.trimmed();
+		// the output of a pipeline marker is not of interest
+		if (!cmd.startsWith("echo \\032kdbg"))
+		    commands.append(cmd);
+		else
+		    commands.append(QByteArray());
+	    }
+	} else if (kind == '<') {
+	    output += line;
+	}
+    }
+
+    /*
+     * A record that does not end with a line break is terminated by one
+     * in the transcript. gdb itself never prints one after the prompt.
+     */
+    output.replace(PROMPT "\n", PROMPT);
+
+    // the initialization ends with the first prompt
+    int pos = output.indexOf(PROMPT);
+    if (pos < 0)
+	return true;
+    pos += PROMPT_LEN;
+
+    for (QList<QByteArray>::iterator c = commands.begin(); c != commands.end(); ++c)
+    {
+	int end = output.indexOf(PROMPT, pos);
+	if (end < 0)
+	    break;
+	Parser p = parserFor(*c);
+	if (p != Pnone) {
+	    Sample s;
+	    s.parser = p;
+	    s.output = output.mid(pos, end-pos);
+	    samples.push_back(s);
+	}
+	pos = end + PROMPT_LEN;
+    }
+    return true;
+}
+
+static long countNodes(const ExprValue* v)
+{
+    long n = 0;
+    for (; v != 0; v = v->m_next)
+	n += 1 + countNodes(v->m_child);
+    return n;
+}
+
+/*
+ * Runs the parser of the sample and returns the number of items that it
+ * produced.
+ */
+static long parse(GdbDriver& driver, const Sample& s)
+{
+    const char* output = s.output.constData();
+    long nodes = 0;
+    switch (s.parser) {
+    case Plocals:
+	{
+	    std::list<ExprValue*> vars;
+	    driver.parseLocals(output, vars);
+	    for (std::list<ExprValue*>::iterator i = vars.begin(); i != vars.end(); ++i) {
+		nodes += countNodes(*i);
+		delete *i;
+	    }
+	}
+	break;
+    case Pprint:
+    case PqcharArray:
+    case PwcharArray:
+	{
+	    ExprValue* v;
+	    if (s.parser == Pprint)
+		v = driver.parsePrintExpr(output, true);
+	    else
+		v = driver.parseQCharArray(output, false, s.parser == PwcharArray);
+	    nodes = countNodes(v);
+	    delete v;
+	}
+	break;
+    case Pbt:
+	{
+	    std::list<StackFrame> stack;
+	    driver.parseBackTrace(output, stack);
+	    nodes = stack.size();
+	}
+	break;
+    case Pbreak:
+	{
+	    std::list<Breakpoint> brks;
+	    driver.parseBreakList(output, brks);
+	    nodes = brks.size();
+	}
+	break;
+    case Pthreads:
+	nodes = driver.parseThreadList(output).size();
+	break;
+    case Pregisters:
+	nodes = driver.parseRegisters(output).size();
+	break;
+    case Pdisassemble:
+	nodes = driver.parseDisassemble(output).size();
+	break;
+    case Pmemory:
+	{
+	    std::list<MemoryDump> memdump;
+	    driver.parseMemoryDump(output, memdump);
+	    nodes = memdump.size();
+	}
+	break;
+    case Pnone:
+	break;
+    }
+    return nodes;
+}
+
+int main(int argc, char** argv)
+{
+    QCoreApplication app(argc, argv);
+    QStringList args = app.arguments();
+    args.removeFirst();
+
+    int iterations = 10;
+    if (args.size() >= 2 && args[0] == "-n") {
+	iterations = qMax(1, args[1].toInt());
+	args.erase(args.begin(), args.begin()+2);
+    }
+    if (args.isEmpty()) {
+	fprintf(stderr, "usage: kdbg-parsebench [-n iterations] transcript...\n");
+	return 2;
+    }
+
+    std::list<Sample> samples;
+    for (QStringList::iterator f = args.begin(); f != args.end(); ++f) {
+	if (!readTranscript(*f, samples))
+	    return 1;
+    }
+    if (samples.empty()) {
+	fprintf(stderr, "no parsable commands found\n");
+	return 1;
+    }
+
+    GdbDriver driver;
+    std::map<Parser, Result> results;
+    QElapsedTimer timer;
+    for (int n = 0; n < iterations; n++)
+    {
+	for (std::list<Sample>::const_iterator s = samples.begin(); s != samples.end(); ++s)
+	{
+	    long allocs = allocCount;
+	    timer.start();
+	    long nodes = parse(driver, *s);
+	    qint64 ns = timer.nsecsElapsed();
+	    Result& r = results[s->parser];
+	    r.allocs += allocCount - allocs;
+	    r.count++;
+	    r.bytes += s->output.size();
+	    r.nsecs += ns;
+	    r.nodes += nodes;
+	}
+    }
+
+    printf("%-24s %8s %10s %10s %9s %12s %10s\n",
+	   "parser", "calls", "MB", "ms", "MB/s", "nodes/s", "allocs/call");
+    for (std::map<Parser, Result>::const_iterator i = results.begin(); i != results.end(); ++i)
+    {
+	const Result& r = i->second;
+	double secs = r.nsecs / 1e9;
+	double mb = r.bytes / (1024.0*1024.0);
+	printf("%-24s %8ld %10.3f %10.1f %9.1f %12.0f %10.1f\n",
+	       parserNames[i->first], r.count, mb, r.nsecs / 1e6,
+	       secs > 0 ? mb / secs : 0.0,
+	       secs > 0 ? r.nodes / secs : 0.0,
+	       double(r.allocs) / r.count);
+    }
+    return 0;
+}
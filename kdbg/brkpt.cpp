@@ -12,6 +12,7 @@
 #include <QLabel>
 #include <QBitmap>
 #include <QPixmap>
+#include <QHash>
 
 #include <QMouseEvent>
 #include "debugger.h"
@@ -61,35 +62,28 @@ BreakpointTable::~BreakpointTable()
 
 void BreakpointTable::updateBreakList()
 {
-    std::list<BreakpointItem*> deletedItems;
-
+    // the items by id; those that remain have gone away
+    QHash<int,BreakpointItem*> deletedItems;
+    deletedItems.reserve(m_ui.bpList->topLevelItemCount());
     for (int i = 0 ; i < m_ui.bpList->topLevelItemCount(); i++)
     {
-        deletedItems.push_back(static_cast<BreakpointItem*>(m_ui.bpList->topLevelItem(i)));
+	BreakpointItem* item = static_cast<BreakpointItem*>(m_ui.bpList->topLevelItem(i));
+	deletedItems.insert(item->id, item);
     }
 
     // get the new list
     for (KDebugger::BrkptROIterator bp = m_debugger->breakpointsBegin(); bp != m_debugger->breakpointsEnd(); ++bp)
     {
 	// look up this item
-	for (std::list<BreakpointItem*>::iterator o = deletedItems.begin(); o != deletedItems.end(); ++o)
-	{
-	    if ((*o)->id == bp->id) {
-		(*o)->updateFrom(*bp);
-		deletedItems.erase(o);	/* don't delete */
-		goto nextItem;
-	    }
-	}
-	// not in the list; add it
-	new BreakpointItem(m_ui.bpList,*bp);
-nextItem:;
+	BreakpointItem* item = deletedItems.take(bp->id);
+	if (item != 0)
+	    item->updateFrom(*bp);
+	else
+	    new BreakpointItem(m_ui.bpList,*bp);
     }
 
     // delete all untouched breakpoints
-    while (!deletedItems.empty()) {
-	delete deletedItems.front();
-	deletedItems.pop_front();
-    }
+    qDeleteAll(deletedItems);
 }
 
 BreakpointItem::BreakpointItem(QTreeWidget* list, const Breakpoint& bp) :
@@ -99,8 +93,21 @@ BreakpointItem::BreakpointItem(QTreeWidget* list, const Breakpoint& bp) :
     display();
 }
 
+/*
+ * Most breakpoints have not changed; only those that did are displayed
+ * anew.
+ */
 void BreakpointItem::updateFrom(const Breakpoint& bp)
 {
+    if (id == bp.id && Breakpoint::type == bp.type && temporary == bp.temporary &&
+	Breakpoint::enabled == bp.enabled && location == bp.location &&
+	Breakpoint::text == bp.text && address == bp.address &&
+	condition == bp.condition && ignoreCount == bp.ignoreCount &&
+	hitCount == bp.hitCount && fileName == bp.fileName &&
+	lineNo == bp.lineNo)
+    {
+	return;
+    }
     Breakpoint::operator=(bp);		/* assign new values */
     display();
 }
@@ -1,6 +1,7 @@
 #ifndef CONFIG_H_Included
 #define CONFIG_H_Included
 
+#cmakedefine HAVE_ELF_H
 #cmakedefine HAVE_FUNC_OPENPTY
 #cmakedefine HAVE_LIBUTIL_H
 #cmakedefine HAVE_PTY_H
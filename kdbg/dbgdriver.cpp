@@ -7,6 +7,7 @@
 #include "dbgdriver.h"
 #include "exprwnd.h"
 #include <QStringList>
+#include <QTimer>
 #include <ctype.h>
 #include <signal.h>
 #include <stdlib.h>			/* strtol, atoi */
@@ -14,10 +15,64 @@
 #include "mydebug.h"
 #include <assert.h>
 
+// how much output of evaluated expressions is kept per stop
+static const int maxEvalCacheSize = 4*1024*1024;
+
+/*
+ * Commands whose output depends only on the location where the program
+ * stopped and the selected frame and thread.
+ */
+static bool isEvalCacheable(DbgCommand cmd)
+{
+    switch (cmd) {
+    case DCprint:
+    case DCprintDeref:
+    case DCprintStruct:
+    case DCprintQStringStruct:
+    case DCprintWChar:
+    case DCprintPopup:
+    case DCfindType:
+	return true;
+    default:
+	return false;
+    }
+}
+
+/*
+ * Commands that neither change the state of the program nor select a
+ * different frame or thread.
+ */
+static bool keepsEvalCache(DbgCommand cmd)
+{
+    switch (cmd) {
+    case DCinfolocals:
+    case DCinforegisters:
+    case DCexamine:
+    case DCbt:
+    case DCinfothreads:
+    case DCinfobreak:
+    case DCinfoline:
+    case DCinfosharedlib:
+    case DCinfotarget:
+    case DCdisassemble:
+    case DCprintBatch:
+	return true;
+    default:
+	return isEvalCacheable(cmd);
+    }
+}
 
 DebuggerDriver::DebuggerDriver() :
+	m_shallowLocals(false),
 	m_state(DSidle),
-	m_activeCmd(0)
+	m_outputScanned(0),
+	m_lopriUnindexed(0),
+	m_activeCmd(0),
+	m_pipelineDepth(1),
+	m_tagCounter(0),
+	m_evalCacheSize(0),
+	m_cachedCmd(0),
+	m_logFileMaxSize(0)
 {
     // debugger process
     connect(this, SIGNAL(readyReadStandardOutput()), SLOT(slotReceiveOutput()));
@@ -30,6 +85,7 @@ DebuggerDriver::~DebuggerDriver()
 {
     flushHiPriQueue();
     flushLoPriQueue();
+    flushPipeline();
 }
 
 
@@ -38,8 +94,11 @@ bool DebuggerDriver::startup(QString cmdStr)
     // clear command queues
     delete m_activeCmd;
     m_activeCmd = 0;
+    m_cachedCmd = 0;
+    flushPipeline();
     flushHiPriQueue();
     flushLoPriQueue();
+    evalCacheClear();
     m_state = DSidle;
 
     // debugger executable
@@ -65,8 +124,7 @@ bool DebuggerDriver::startup(QString cmdStr)
 
     // open log file
     if (!m_logFile.isOpen() && !m_logFileName.isEmpty()) {
-	m_logFile.setFileName(m_logFileName);
-	m_logFile.open(QIODevice::WriteOnly);
+	m_logFile.open(m_logFileName, m_logFileMaxSize);
     }
 
     return true;
@@ -74,15 +132,19 @@ bool DebuggerDriver::startup(QString cmdStr)
 
 void DebuggerDriver::slotExited()
 {
-    static const char txt[] = "\n====== debugger exited ======\n";
     if (m_logFile.isOpen()) {
-	m_logFile.write(txt,sizeof(txt)-1);
+	m_logFile.write(Transcript::RNote, "====== debugger exited ======\n");
+	m_logFile.flush();
     }
 
     // reset state
     m_state = DSidle;
+    // the pipelined commands will never finish
+    flushPipeline();
+    evalCacheClear();
     // empty buffer
     m_output.clear();
+    m_outputScanned = 0;
 }
 
 
@@ -91,16 +153,28 @@ CmdQueueItem* DebuggerDriver::executeCmdString(DbgCommand cmd,
 {
     // place a new command into the high-priority queue
     CmdQueueItem* cmdItem = new CmdQueueItem(cmd, cmdString);
+    cmdItem->m_queuedAt = m_perf.now();
+    TRACE_ASYNC_BEGIN("queued", cmdItem, cmdString.trimmed());
     m_hipriCmdQueue.push(cmdItem);
 
     if (clearLow) {
-	if (m_state == DSrunningLow) {
+	if (m_state == DSrunningLow &&
+	    (!m_pipelinedCmds.empty() || (m_activeCmd != 0 && m_activeCmd->m_pipeTag != 0)))
+	{
+	    /*
+	     * gdb would execute the commands that were sent after the
+	     * running one even if we interrupted it. Let them finish, but
+	     * ignore their output.
+	     */
+	    cancelPipeline();
+	} else if (m_state == DSrunningLow) {
 	    // take the liberty to interrupt the running command
 	    m_state = DSinterrupted;
 	    ::kill(pid(), SIGINT);
 	    ASSERT(m_activeCmd != 0);
 	    TRACE(QString::asprintf("interrupted the command %d",
 		  (m_activeCmd ? m_activeCmd->m_cmd : -1)));
+	    TRACE_ASYNC_END("debugger", m_activeCmd);
 	    delete m_activeCmd;
 	    m_activeCmd = 0;
 	}
@@ -130,28 +204,36 @@ CmdQueueItem* DebuggerDriver::queueCmdString(DbgCommand cmd,
     case QMoverrideMoreEqual:
     case QMoverride:
 	// check whether gdb is currently processing this command
-	if (m_activeCmd != 0 &&
+	if (m_activeCmd != 0 && !m_activeCmd->m_cancelled &&
 	    m_activeCmd->m_cmd == cmd && m_activeCmd->m_cmdString == cmdString)
 	{
 	    return m_activeCmd;
 	}
+	// check whether the command was pipelined
+	i = find_if(m_pipelinedCmds.begin(), m_pipelinedCmds.end(), CmdQueueItem::IsEqualCmd(cmd, cmdString));
+	if (i != m_pipelinedCmds.end() && !(*i)->m_cancelled) {
+	    return *i;
+	}
 	// check whether there is already the same command in the queue
-	i = find_if(m_lopriCmdQueue.begin(), m_lopriCmdQueue.end(), CmdQueueItem::IsEqualCmd(cmd, cmdString));
-	if (i != m_lopriCmdQueue.end()) {
+	cmdItem = lopriFind(cmd, cmdString);
+	if (cmdItem != 0) {
 	    // found one
-	    cmdItem = *i;
 	    if (mode == QMoverrideMoreEqual) {
 		// All commands are equal, but some are more equal than others...
 		// put this command in front of all others
-		m_lopriCmdQueue.erase(i);
-		m_lopriCmdQueue.push_front(cmdItem);
+		m_lopriCmdQueue.splice(m_lopriCmdQueue.begin(), m_lopriCmdQueue,
+				       cmdItem->m_queuePos);
 	    }
+	    // the caller may assign a different m_expr
+	    lopriUnindexVar(cmdItem);
 	    break;
 	} // else none found, so add it
 	// fall through
     case QMnormal:
 	cmdItem = new CmdQueueItem(cmd, cmdString);
-	m_lopriCmdQueue.push_back(cmdItem);
+	cmdItem->m_queuedAt = m_perf.now();
+	TRACE_ASYNC_BEGIN("queued", cmdItem, cmdString.trimmed());
+	lopriInsert(cmdItem, false);
     }
 
     // if gdb is idle, send it the command
@@ -178,7 +260,7 @@ void DebuggerDriver::writeCommand()
 	m_hipriCmdQueue.pop();
     } else if (!m_lopriCmdQueue.empty()) {
 	cmd = m_lopriCmdQueue.front();
-	m_lopriCmdQueue.pop_front();
+	lopriRemove(cmd);
 	newState = DScommandSentLow;
     } else {
 	// nothing to do
@@ -187,9 +269,36 @@ void DebuggerDriver::writeCommand()
     }
 
     m_activeCmd = cmd;
+    cmd->m_sentAt = m_perf.now();
     TRACE("in writeCommand: " + cmd->m_cmdString);
+    TRACE_ASYNC_END("queued", cmd);
+    TRACE_ASYNC_BEGIN("debugger", cmd, cmd->m_cmdString.trimmed());
+
+    const QByteArray* result = evalCacheFind(cmd);
+    if (result != 0) {
+	m_cachedCmd = cmd;
+	m_cachedOutput = *result;
+	m_state = newState;
+	QTimer::singleShot(0, this, SLOT(slotCachedResult()));
+	return;
+    }
+    if (!keepsEvalCache(cmd->m_cmd))
+	evalCacheClear();
+
+    // send more low-priority commands along if possible
+    if (newState == DScommandSentLow && m_pipelineDepth > 1 && canPipeline(cmd))
+	cmd->m_pipeTag = ++m_tagCounter;
+
+    QByteArray str = commandBytes(cmd);
+    if (cmd->m_pipeTag != 0)
+	str += pipelineBytes();
+    writeBytes(str);
+
+    m_state = newState;
+}
 
-    QByteArray str = cmd->m_cmdString.toLocal8Bit();
+void DebuggerDriver::writeBytes(const QByteArray& str)
+{
     const char* data = str.data();
     qint64 len = str.length();
     while (len > 0) {
@@ -202,24 +311,148 @@ void DebuggerDriver::writeCommand()
 
     // write also to log file
     if (m_logFile.isOpen()) {
-	m_logFile.write(str);
-	m_logFile.flush();
+	m_logFile.write(Transcript::RCommand, str);
     }
+}
 
-    m_state = newState;
+/*
+ * Takes low-priority commands from the queue and appends them to the
+ * pipeline until it is full. Returns the bytes to send to the debugger.
+ */
+QByteArray DebuggerDriver::pipelineBytes()
+{
+    QByteArray str;
+    while (int(m_pipelinedCmds.size()) + 1 < m_pipelineDepth &&
+	   m_hipriCmdQueue.empty() && !m_lopriCmdQueue.empty() &&
+	   canPipeline(m_lopriCmdQueue.front()) &&
+	   evalCacheFind(m_lopriCmdQueue.front()) == 0)
+    {
+	CmdQueueItem* cmd = m_lopriCmdQueue.front();
+	lopriRemove(cmd);
+	TRACE("pipelining: " + cmd->m_cmdString);
+	cmd->m_pipeTag = ++m_tagCounter;
+	cmd->m_committed = true;
+	cmd->m_sentAt = m_perf.now();
+	TRACE_ASYNC_END("queued", cmd);
+	TRACE_ASYNC_BEGIN("debugger", cmd, cmd->m_cmdString.trimmed());
+	m_pipelinedCmds.push_back(cmd);
+	str += commandBytes(cmd);
+    }
+    return str;
+}
+
+QByteArray DebuggerDriver::commandBytes(CmdQueueItem* cmd)
+{
+    return cmd->m_cmdString.toLocal8Bit();
+}
+
+bool DebuggerDriver::canPipeline(const CmdQueueItem*) const
+{
+    return false;
+}
+
+int DebuggerDriver::findPipeMarker(const QByteArray&, uint, int&, int&) const
+{
+    return -1;
+}
+
+// the output of commands in flight is consumed, but not parsed
+void DebuggerDriver::cancelPipeline()
+{
+    if (m_activeCmd != 0)
+	m_activeCmd->m_cancelled = true;
+    for (std::list<CmdQueueItem*>::iterator i = m_pipelinedCmds.begin(); i != m_pipelinedCmds.end(); ++i)
+	(*i)->m_cancelled = true;
+}
+
+void DebuggerDriver::flushPipeline()
+{
+    while (!m_pipelinedCmds.empty()) {
+	TRACE_ASYNC_END("debugger", m_pipelinedCmds.front());
+	delete m_pipelinedCmds.front();
+	m_pipelinedCmds.pop_front();
+    }
 }
 
 void DebuggerDriver::flushLoPriQueue()
 {
     while (!m_lopriCmdQueue.empty()) {
+	TRACE_ASYNC_END("queued", m_lopriCmdQueue.back());
 	delete m_lopriCmdQueue.back();
 	m_lopriCmdQueue.pop_back();
     }
+    m_lopriByString.clear();
+    m_lopriByVar.clear();
+    m_lopriUnindexed = 0;
+}
+
+void DebuggerDriver::lopriInsert(CmdQueueItem* cmd, bool front)
+{
+    lopriIndexVar();
+    if (front) {
+	m_lopriCmdQueue.push_front(cmd);
+	cmd->m_queuePos = m_lopriCmdQueue.begin();
+    } else {
+	m_lopriCmdQueue.push_back(cmd);
+	cmd->m_queuePos = --m_lopriCmdQueue.end();
+    }
+    m_lopriByString.insert(cmd->m_cmdString, cmd);
+    m_lopriUnindexed = cmd;
+}
+
+void DebuggerDriver::lopriRemove(CmdQueueItem* cmd)
+{
+    if (cmd == m_lopriUnindexed)
+	m_lopriUnindexed = 0;
+    if (cmd->m_exprRoot != 0) {
+	m_lopriByVar.remove(cmd->m_exprRoot, cmd);
+	cmd->m_exprRoot = 0;
+    }
+    m_lopriByString.remove(cmd->m_cmdString, cmd);
+    m_lopriCmdQueue.erase(cmd->m_queuePos);
+}
+
+CmdQueueItem* DebuggerDriver::lopriFind(DbgCommand cmd, const QString& cmdString) const
+{
+    QMultiHash<QString, CmdQueueItem*>::const_iterator i = m_lopriByString.find(cmdString);
+    for (; i != m_lopriByString.end() && i.key() == cmdString; ++i) {
+	if ((*i)->m_cmd == cmd)
+	    return *i;
+    }
+    return 0;
+}
+
+void DebuggerDriver::lopriUnindexVar(CmdQueueItem* cmd)
+{
+    lopriIndexVar();
+    if (cmd->m_exprRoot != 0) {
+	m_lopriByVar.remove(cmd->m_exprRoot, cmd);
+	cmd->m_exprRoot = 0;
+    }
+    m_lopriUnindexed = cmd;
+}
+
+// adds the last queued command to the index by variable
+void DebuggerDriver::lopriIndexVar()
+{
+    CmdQueueItem* cmd = m_lopriUnindexed;
+    if (cmd == 0)
+	return;
+    m_lopriUnindexed = 0;
+
+    if (cmd->m_expr != 0) {
+	const QTreeWidgetItem* root = cmd->m_expr;
+	while (root->parent() != 0)
+	    root = root->parent();
+	cmd->m_exprRoot = root;
+	m_lopriByVar.insert(root, cmd);
+    }
 }
 
 void DebuggerDriver::flushHiPriQueue()
 {
     while (!m_hipriCmdQueue.empty()) {
+	TRACE_ASYNC_END("queued", m_hipriCmdQueue.front());
 	delete m_hipriCmdQueue.front();
 	m_hipriCmdQueue.pop();
     }
@@ -237,6 +470,13 @@ void DebuggerDriver::slotCommandRead()
 {
     TRACE(__PRETTY_FUNCTION__);
 
+    // the debugger read commands that were added to the pipeline later
+    if (m_state == DSrunningLow && m_activeCmd != 0 && m_activeCmd->m_pipeTag != 0)
+	return;
+    // the debugger did not even see a command that was answered from the cache
+    if (m_activeCmd != 0 && m_activeCmd == m_cachedCmd)
+	return;
+
     // there must be an active command which is not yet commited
     ASSERT(m_state == DScommandSent || m_state == DScommandSentLow);
     ASSERT(m_activeCmd != 0);
@@ -293,8 +533,7 @@ void DebuggerDriver::processOutput(const QByteArray& data)
 {
     // write to log file (do not log delayed output - it would appear twice)
     if (m_logFile.isOpen()) {
-	m_logFile.write(data);
-	m_logFile.flush();
+	m_logFile.write(Transcript::ROutput, data);
     }
     
     /*
@@ -313,15 +552,35 @@ void DebuggerDriver::processOutput(const QByteArray& data)
 
     // collect output until next prompt string is found
     
-    // accumulate it
+    /*
+     * Accumulate it. The prompt is searched only in the part of the output
+     * that has not been searched before, so that long output is not
+     * scanned over and over again.
+     */
+    if (m_output.isEmpty() && m_activeCmd != 0)
+	TRACE_INSTANT("first output", m_activeCmd->m_cmdString.trimmed());
     m_output += data;
 
-    // check for a prompt
-    int promptStart = findPrompt(m_output);
-    if (promptStart >= 0)
-    {
+    for (;;) {
+	// check for a prompt
+	int consumed = -1;
+	int promptStart;
+	if (m_activeCmd != 0 && m_activeCmd->m_pipeTag != 0) {
+	    promptStart = findPipeMarker(m_output, m_activeCmd->m_pipeTag,
+					 consumed, m_outputScanned);
+	} else {
+	    promptStart = findPrompt(m_output, m_outputScanned);
+	}
+	if (promptStart < 0)
+	    break;
+
 	// found prompt!
 
+	// keep the output of the next pipelined command
+	QByteArray rest;
+	if (consumed >= 0)
+	    rest = m_output.mid(consumed);
+
 	// terminate output before the prompt
 	m_output.resize(promptStart);
 
@@ -338,17 +597,35 @@ void DebuggerDriver::processOutput(const QByteArray& data)
 	    ASSERT(m_state != DSidle);
 	    CmdQueueItem* cmd = m_activeCmd;
 	    m_activeCmd = 0;
-	    commandFinished(cmd);
+	    TRACE_ASYNC_END("debugger", cmd);
+	    if (!cmd->m_cancelled) {
+		evalCacheInsert(cmd, m_output);
+		finishCommand(cmd, false);
+	    }
 	    delete cmd;
 	}
 
 	// empty buffer
-	m_output.clear();
+	m_output = rest;
+	m_outputScanned = 0;
 	// also clear delayed output if interrupted
 	if (m_state == DSinterrupted) {
 	    m_delayedOutput = std::queue<QByteArray>();
 	}
 
+	/*
+	 * If more commands were pipelined, the debugger is already working
+	 * on the next one. Keep the pipeline filled.
+	 */
+	if (!m_pipelinedCmds.empty()) {
+	    m_activeCmd = m_pipelinedCmds.front();
+	    m_pipelinedCmds.pop_front();
+	    QByteArray more = pipelineBytes();
+	    if (!more.isEmpty())
+		writeBytes(more);
+	    continue;
+	}
+
 	/*
 	 * We parsed some output successfully. Unless there's more delayed
 	 * output, the debugger must be idle now, so send down the next
@@ -363,27 +640,147 @@ void DebuggerDriver::processOutput(const QByteArray& data)
 		writeCommand();
 	    }
 	}
+	break;
+    }
+}
+
+const QByteArray* DebuggerDriver::evalCacheFind(const CmdQueueItem* cmd) const
+{
+    if (!isEvalCacheable(cmd->m_cmd))
+	return 0;
+    QHash<QString, QByteArray>::const_iterator i = m_evalCache.find(cmd->m_cmdString);
+    return i == m_evalCache.end() ? 0 : &*i;
+}
+
+void DebuggerDriver::evalCacheInsert(const CmdQueueItem* cmd, const QByteArray& output)
+{
+    if (!isEvalCacheable(cmd->m_cmd) ||
+	m_evalCacheSize + output.size() > maxEvalCacheSize)
+	return;
+    if (!m_evalCache.contains(cmd->m_cmdString)) {
+	m_evalCache.insert(cmd->m_cmdString, output);
+	m_evalCacheSize += output.size();
+    }
+}
+
+void DebuggerDriver::evalCacheClear()
+{
+    m_evalCache.clear();
+    m_evalCacheSize = 0;
+}
+
+/*
+ * Completes the active command with output that was found in the cache.
+ */
+void DebuggerDriver::slotCachedResult()
+{
+    // the command may have been removed in the meantime
+    if (m_cachedCmd == 0 || m_cachedCmd != m_activeCmd)
+	return;
+
+    CmdQueueItem* cmd = m_activeCmd;
+    m_activeCmd = 0;
+    m_cachedCmd = 0;
+    cmd->m_committed = true;
+    TRACE("from cache: " + cmd->m_cmdString);
+    TRACE_ASYNC_END("debugger", cmd);
+    if (m_logFile.isOpen()) {
+	m_logFile.write(Transcript::RNote, "from cache: " + cmd->m_cmdString.toLocal8Bit());
+    }
+
+    // same as if the debugger had sent the output
+    m_state = m_state == DScommandSent ? DSrunning : DSrunningLow;
+    QByteArray pending;
+    pending.swap(m_output);
+    m_output.swap(m_cachedOutput);
+    finishCommand(cmd, true);
+    delete cmd;
+    m_output.swap(pending);
+    m_cachedOutput.clear();
+
+    if (m_hipriCmdQueue.empty() && m_lopriCmdQueue.empty()) {
+	m_state = DSidle;
+	emit enterIdleState();
+    } else {
+	writeCommand();
     }
 }
 
+/*
+ * Hands the output in m_output to commandFinished() and records how long
+ * the command took.
+ */
+void DebuggerDriver::finishCommand(CmdQueueItem* cmd, bool fromCache)
+{
+    qint64 received = m_perf.now();
+    int bytes = m_output.size();
+    {
+	TraceSpan span("parse", dbgCommandName(cmd->m_cmd));
+	commandFinished(cmd);
+    }
+    m_perf.addCommand(cmd->m_cmd, cmd->m_queuedAt, cmd->m_sentAt,
+		      received, m_perf.now(), bytes, fromCache);
+}
+
+/*
+ * The commands are indexed under the top-level item of their variable,
+ * so var must still be attached to its ExprWnd. If it is not, the whole
+ * queue is searched.
+ */
 void DebuggerDriver::dequeueCmdByVar(VarTree* var)
 {
     if (var == 0)
 	return;
 
-    std::list<CmdQueueItem*>::iterator i = m_lopriCmdQueue.begin();
-    while (i != m_lopriCmdQueue.end()) {
-	if ((*i)->m_expr != 0 && var->isAncestorEq((*i)->m_expr)) {
+    // only the commands below the same top-level variable are candidates
+    lopriIndexVar();
+    const QTreeWidgetItem* root = var;
+    while (root->parent() != 0)
+	root = root->parent();
+    ASSERT(root->treeWidget() != 0);
+    QList<CmdQueueItem*> candidates;
+    if (root->treeWidget() != 0) {
+	candidates = m_lopriByVar.values(root);
+    } else {
+	for (std::list<CmdQueueItem*>::iterator i = m_lopriCmdQueue.begin(); i != m_lopriCmdQueue.end(); ++i) {
+	    if ((*i)->m_expr != 0)
+		candidates.append(*i);
+	}
+    }
+    foreach (CmdQueueItem* cmd, candidates) {
+	if (var->isAncestorEq(cmd->m_expr)) {
 	    // this is indeed a critical command; delete it
-	    TRACE("removing critical lopri-cmd: " + (*i)->m_cmdString);
-	    delete *i;
-	    m_lopriCmdQueue.erase(i++);
-	} else
-	    ++i;
+	    TRACE("removing critical lopri-cmd: " + cmd->m_cmdString);
+	    TRACE_ASYNC_END("queued", cmd);
+	    lopriRemove(cmd);
+	    delete cmd;
+	}
+    }
+
+    std::list<CmdQueueItem*>::iterator i;
+
+    // commands in flight cannot be taken back; ignore their output
+    if (m_activeCmd != 0 && m_activeCmd->m_pipeTag != 0 &&
+	m_activeCmd->m_expr != 0 && var->isAncestorEq(m_activeCmd->m_expr))
+    {
+	m_activeCmd->m_cancelled = true;
+    }
+    for (i = m_pipelinedCmds.begin(); i != m_pipelinedCmds.end(); ++i) {
+	if ((*i)->m_expr != 0 && var->isAncestorEq((*i)->m_expr))
+	    (*i)->m_cancelled = true;
     }
 }
 
 
+bool DebuggerDriver::canPrintBatch() const
+{
+    return false;
+}
+
+void DebuggerDriver::parsePrintBatch(const char*, std::list<ExprValue*>&)
+{
+}
+
 QString DebuggerDriver::editableValue(VarTree* value)
 {
     // by default, let the user edit what is visible
@@ -7,11 +7,13 @@
 #ifndef DBGDRIVER_H
 #define DBGDRIVER_H
 
-#include <QFile>
 #include <QByteArray>
+#include <QHash>
 #include <QProcess>
 #include <queue>
 #include <list>
+#include "transcript.h"
+#include "perfstats.h"
 
 
 class VarTree;
@@ -19,6 +21,7 @@ class ExprValue;
 class ExprWnd;
 class KDebugger;
 class QStringList;
+class QTreeWidgetItem;
 
 
 /**
@@ -62,7 +65,7 @@ enum DbgCommand {
 	DCunsetenv,
 	DCsetoption,                    /* debugger options */
 	DCcd,
-	DCbt,
+	DCbt,				/* innermost frames up to a count */
 	DCrun,
 	DCcont,
 	DCstep,
@@ -97,7 +100,8 @@ enum DbgCommand {
 	DCsetpc,
 	DCignore,
 	DCprintWChar,
-	DCsetvariable
+	DCsetvariable,
+	DCprintBatch			/* several expressions, separated by '\n' */
 };
 
 enum RunDevNull {
@@ -141,6 +145,10 @@ struct Breakpoint;
  * that it's done with the command by sending the prompt. The output of the
  * debugger is parsed at that time. Then, if more commands are in the
  * queue, the next one is sent to the debugger.
+ *
+ * In pipelined mode, several low-priority commands are sent at once. Each
+ * one is tagged so that its output can be told apart from the output of
+ * the commands that follow it.
  */
 struct CmdQueueItem
 {
@@ -161,6 +169,19 @@ struct CmdQueueItem
     bool m_byUser;
     // used to store the expression to print in case of DCprintPopup is executed
     QString m_popupExpr;
+    // the expressions of a DCprintBatch command
+    std::list<QString> m_batchExprs;
+    // identifies the output of a pipelined command; zero if not pipelined
+    uint m_pipeTag;
+    // the output of the command is to be ignored
+    bool m_cancelled;
+    // the position in the low-priority queue
+    std::list<CmdQueueItem*>::iterator m_queuePos;
+    // the top-level variable under which the command is indexed
+    const QTreeWidgetItem* m_exprRoot;
+    // when the command was queued and sent, see PerfStats::now()
+    qint64 m_queuedAt;
+    qint64 m_sentAt;
 
     CmdQueueItem(DbgCommand cmd, const QString& str) :
     	m_cmd(cmd),
@@ -171,7 +192,12 @@ struct CmdQueueItem
 	m_lineNo(0),
 	m_brkpt(0),
 	m_existingBrkpt(0),
-	m_byUser(false)
+	m_byUser(false),
+	m_pipeTag(0),
+	m_cancelled(false),
+	m_exprRoot(0),
+	m_queuedAt(0),
+	m_sentAt(0)
     { }
 
     struct IsEqualCmd
@@ -297,11 +323,29 @@ public:
     virtual QStringList boolOptionList() const = 0;
 
     virtual bool startup(QString cmdStr);
-    void setLogFileName(const QString& fname) { m_logFileName = fname; }
+    /**
+     * Sets the file where the transcript is written. If \a maxSize is not
+     * zero, the file is rotated when it grows larger.
+     */
+    void setLogFileName(const QString& fname, qint64 maxSize = 0)
+    { m_logFileName = fname; m_logFileMaxSize = maxSize; }
+    /**
+     * Sets how many low-priority commands may be sent to the debugger
+     * before the output of the first one has arrived. 1 turns pipelining
+     * off.
+     */
+    void setPipelineDepth(int depth) { m_pipelineDepth = depth < 1 ? 1 : depth; }
+    /**
+     * In shallow mode, the local variables are listed without the members
+     * of structs and arrays, if the debugger supports that. The members
+     * are fetched when a variable is expanded.
+     */
+    void setShallowLocals(bool shallow) { m_shallowLocals = shallow; }
     bool isRunning() { return state() != NotRunning; }
 
 protected:
     QString m_runCmd;
+    bool m_shallowLocals;		/* see setShallowLocals() */
     
     enum DebuggerState {
 	DSidle,				/* gdb waits for input */
@@ -319,9 +363,15 @@ public:
      * Tells whether a high prority command would be executed immediately.
      */
     bool canExecuteImmediately() const { return m_hipriCmdQueue.empty(); }
+    int hipriQueueDepth() const { return int(m_hipriCmdQueue.size()); }
+    int lopriQueueDepth() const { return int(m_lopriCmdQueue.size()); }
+    int commandsInFlight() const
+    { return int(m_pipelinedCmds.size()) + (m_activeCmd != 0 ? 1 : 0); }
+    PerfStats& perfStats() { return m_perf; }
 
 protected:
     QByteArray m_output;		// normal gdb output
+    int m_outputScanned;		// where to resume the search for the prompt
     std::queue<QByteArray> m_delayedOutput;	// output colleced before signal bytesWritten() arrived
 
 public:
@@ -484,6 +534,20 @@ public:
      */
     virtual ExprValue* parsePrintExpr(const char* output, bool wantErrorValue) = 0;
 
+    /**
+     * Tells whether the driver can evaluate several expressions with one
+     * DCprintBatch command.
+     */
+    virtual bool canPrintBatch() const;
+
+    /**
+     * Parses the output of the DCprintBatch command. \a values receives
+     * one value per expression in the order in which they were given;
+     * an entry is 0 if the output could not be parsed. Error messages are
+     * returned as values.
+     */
+    virtual void parsePrintBatch(const char* output, std::list<ExprValue*>& values);
+
     /**
      * Parses the output of the DCcd command.
      * @return false if the message is an error message.
@@ -582,10 +646,31 @@ protected:
 
     std::queue<CmdQueueItem*> m_hipriCmdQueue;
     std::list<CmdQueueItem*> m_lopriCmdQueue;
+    /**
+     * The low-priority commands indexed by command string and by the
+     * top-level variable that they update. The last queued command is
+     * added to the latter index only later because its m_expr is set
+     * after it was queued.
+     */
+    QMultiHash<QString, CmdQueueItem*> m_lopriByString;
+    QMultiHash<const QTreeWidgetItem*, CmdQueueItem*> m_lopriByVar;
+    CmdQueueItem* m_lopriUnindexed;
+    void lopriInsert(CmdQueueItem* cmd, bool front);
+    void lopriRemove(CmdQueueItem* cmd);
+    CmdQueueItem* lopriFind(DbgCommand cmd, const QString& cmdString) const;
+    void lopriIndexVar();
+    void lopriUnindexVar(CmdQueueItem* cmd);
     /**
      * The active command is kept separately from other pending commands.
      */
     CmdQueueItem* m_activeCmd;
+    /**
+     * Pipelined commands that were sent after the active command; their
+     * output follows the output of the active command.
+     */
+    std::list<CmdQueueItem*> m_pipelinedCmds;
+    int m_pipelineDepth;		/* max. number of commands in flight */
+    uint m_tagCounter;			/* the last tag handed out */
     /**
      * Helper function that queues the given command string in the
      * low-priority queue.
@@ -599,6 +684,37 @@ protected:
     CmdQueueItem* executeCmdString(DbgCommand cmd, QString cmdString,
 				   bool clearLow);
     void writeCommand();
+    void writeBytes(const QByteArray& str);
+    QByteArray pipelineBytes();
+    void cancelPipeline();
+    void flushPipeline();
+    /**
+     * The output of commands that evaluate expressions, keyed by the
+     * command string. It is valid until a command is sent that may change
+     * the state of the program or select a different frame or thread. A
+     * command whose output is known is not sent to the debugger; the
+     * output is delivered from the event loop instead, because the caller
+     * may not have finished setting up the command, yet.
+     */
+    QHash<QString, QByteArray> m_evalCache;
+    int m_evalCacheSize;		/* bytes in m_evalCache */
+    CmdQueueItem* m_cachedCmd;		/* active command answered from the cache */
+    QByteArray m_cachedOutput;
+    const QByteArray* evalCacheFind(const CmdQueueItem* cmd) const;
+    void evalCacheInsert(const CmdQueueItem* cmd, const QByteArray& output);
+    void evalCacheClear();
+    PerfStats m_perf;
+    void finishCommand(CmdQueueItem* cmd, bool fromCache);
+    /**
+     * Returns the bytes that are written to the debugger for \a cmd. The
+     * default is the command string in the local 8-bit encoding.
+     */
+    virtual QByteArray commandBytes(CmdQueueItem* cmd);
+    /**
+     * Tells whether the low-priority command \a cmd may be sent to the
+     * debugger while it is still working on earlier commands.
+     */
+    virtual bool canPipeline(const CmdQueueItem* cmd) const;
     virtual void commandFinished(CmdQueueItem* cmd) = 0;
     virtual QString makeCmdString(DbgCommand cmd) = 0;
     virtual QString makeCmdString(DbgCommand cmd, QString strArg) = 0;
@@ -613,14 +729,29 @@ protected:
 
     /**
      * Returns the start of the prompt in \a output or -1.
-     * \a len specifies the size of \a output, but in addition, the contents
-     * of \a output are NUL-terminated, i.e., \c output[len] is zero.
+     * The contents of \a output are NUL-terminated.
+     *
+     * \a scanned is the offset up to which \a output was searched by
+     * earlier calls; it is 0 when new output begins. The function updates
+     * it so that the next call, after more output has arrived, need not
+     * search the same bytes again.
+     */
+    virtual int findPrompt(const QByteArray& output, int& scanned) const = 0;
+
+    /**
+     * Looks for the end of the output of the pipelined command that has
+     * the tag \a tag. Returns the length of the command's output in
+     * \a output or -1 if it is not complete, yet. \a consumed receives
+     * the number of bytes that belong to the command, including the
+     * marker that ends it. \a scanned is used as in findPrompt().
      */
-    virtual int findPrompt(const QByteArray& output) const = 0;
+    virtual int findPipeMarker(const QByteArray& output, uint tag,
+			       int& consumed, int& scanned) const;
 
     // log file
     QString m_logFileName;
-    QFile m_logFile;
+    qint64 m_logFileMaxSize;
+    Transcript m_logFile;
 
 public slots:
     void dequeueCmdByVar(VarTree* var);
@@ -628,6 +759,7 @@ public slots:
 protected slots:
     virtual void slotReceiveOutput();
     virtual void slotCommandRead();
+    void slotCachedResult();
     virtual void slotExited();
     
 signals:
@@ -38,12 +38,14 @@
 #include "brkpt.h"
 #include "threadlist.h"
 #include "memwindow.h"
+#include "perfwnd.h"
 #include "ttywnd.h"
 #include "watchwindow.h"
 #include "procattach.h"
 #include "prefdebugger.h"
 #include "prefmisc.h"
 #include "gdbdriver.h"
+#include "gdbmidriver.h"
 #include "xsldbgdriver.h"
 #include "mydebug.h"
 #include <typeinfo>
@@ -55,12 +57,22 @@ static const char defaultTermCmdStr[] = "xterm -name kdbgio -title %T -e sh -c %
 static const char defaultSourceFilter[] = "*.c *.cc *.cpp *.c++ *.C *.CC";
 static const char defaultHeaderFilter[] = "*.h *.hh *.hpp *.h++";
 
+/*
+ * Several main windows can run in the same process, each with its own
+ * debugger. They share the type libraries and the caches.
+ */
+static int nextSessionNo = 0;
+
 DebuggerMainWnd::DebuggerMainWnd() :
 	KXmlGuiWindow(),
+	m_sessionNo(nextSessionNo++),
 	m_debugger(0),
+	m_pipelineDepth(1),
+	m_shallowLocals(false),
 #ifdef GDB_TRANSCRIPT
 	m_transcriptFile(GDB_TRANSCRIPT),
 #endif
+	m_transcriptMaxSize(0),
 	m_outputTermCmdStr(defaultTermCmdStr),
 	m_outputTermProc(new QProcess),
 	m_ttyLevel(-1),			/* no tty yet */
@@ -78,6 +90,8 @@ DebuggerMainWnd::DebuggerMainWnd() :
 
     QDockWidget* dw1 = createDockWidget("Stack", i18n("Stack"));
     m_btWindow = new QListWidget(dw1);
+    // all frames are one line; the list need not measure each of them
+    m_btWindow->setUniformItemSizes(true);
     dw1->setWidget(m_btWindow);
     QDockWidget* dw2 = createDockWidget("Locals", i18n("Locals"));
     m_localVariables = new ExprWnd(dw2, i18n("Variable"));
@@ -100,6 +114,9 @@ DebuggerMainWnd::DebuggerMainWnd() :
     QDockWidget* dw8 = createDockWidget("Memory", i18n("Memory"));
     m_memoryWindow = new MemoryWindow(dw8);
     dw8->setWidget(m_memoryWindow);
+    QDockWidget* dw9 = createDockWidget("Performance", i18n("Performance"));
+    m_perfWindow = new PerfWindow(dw9);
+    dw9->setWidget(m_perfWindow);
 
     m_debugger = new KDebugger(this, m_localVariables, m_watches->watchVariables(), m_btWindow);
 
@@ -109,6 +126,7 @@ DebuggerMainWnd::DebuggerMainWnd() :
     connect(m_debugger, SIGNAL(debuggerStarting()), SLOT(slotDebuggerStarting()));
     m_bpTable->setDebugger(m_debugger);
     m_memoryWindow->setDebugger(m_debugger);
+    m_perfWindow->setDebugger(m_debugger);
 
     setStandardToolBarMenuEnabled(true);
     initKAction();
@@ -173,6 +191,20 @@ DebuggerMainWnd::DebuggerMainWnd() :
     connect(m_threads, SIGNAL(setThread(int)),
 	    m_debugger, SLOT(setThread(int)));
 
+    /*
+     * Views that are hidden are not updated when the program stops. The
+     * docks are not shown yet; they report when they become visible.
+     */
+    connect(dw4, SIGNAL(visibilityChanged(bool)),
+	    m_debugger, SLOT(setRegistersVisible(bool)));
+    connect(dw8, SIGNAL(visibilityChanged(bool)),
+	    m_debugger, SLOT(setMemoryVisible(bool)));
+    connect(dw7, SIGNAL(visibilityChanged(bool)),
+	    m_debugger, SLOT(setThreadsVisible(bool)));
+    m_debugger->setRegistersVisible(false);
+    m_debugger->setMemoryVisible(false);
+    m_debugger->setThreadsVisible(false);
+
     // popup menu of the local variables window
     m_localVariables->setContextMenuPolicy(Qt::CustomContextMenu);
     connect(m_localVariables, SIGNAL(customContextMenuRequested(const QPoint&)),
@@ -197,6 +229,7 @@ DebuggerMainWnd::~DebuggerMainWnd()
     delete m_debugger;
     m_debugger = 0;
 
+    delete m_perfWindow;
     delete m_memoryWindow;
     delete m_threads;
     delete m_ttyWindow;
@@ -263,6 +296,8 @@ void DebuggerMainWnd::initKAction()
     m_recentExecAction->setText(i18n("Recent E&xecutables"));
     m_coreDumpAction = createAction(i18n("&Core Dump..."), 0,
 			this, SLOT(slotFileCore()), "file_core_dump");
+    createAction(i18n("&New Window"), "window-new", 0,
+			this, SLOT(slotFileNewWindow()), "file_new_window");
     KStandardAction::quit(this, SLOT(close()), actionCollection());
 
     // settings menu
@@ -286,7 +321,8 @@ void DebuggerMainWnd::initKAction()
 	{ m_bpTable, "view_breakpoints", &m_bpTableAction },
 	{ m_threads, "view_threads", &m_threadsAction },
 	{ m_ttyWindow, "view_output", &m_ttyWindowAction },
-	{ m_memoryWindow, "view_memory", &m_memoryWindowAction }
+	{ m_memoryWindow, "view_memory", &m_memoryWindowAction },
+	{ m_perfWindow, "view_performance", &m_perfWindowAction }
     };
     for (unsigned i = 0; i < sizeof(dw)/sizeof(dw[0]); i++) {
 	QDockWidget* d = dockParent(dw[i].w);
@@ -439,6 +475,8 @@ static const char TermCmdStr[] = "TermCmdStr";
 static const char KeepScript[] = "KeepScript";
 static const char DebuggerGroup[] = "Debugger";
 static const char DebuggerCmdStr[] = "DebuggerCmdStr";
+static const char PipelineDepth[] = "PipelineDepth";
+static const char ShallowLocals[] = "ShallowLocals";
 static const char PreferencesGroup[] = "Preferences";
 static const char PopForeground[] = "PopForeground";
 static const char BackTimeout[] = "BackTimeout";
@@ -460,7 +498,10 @@ void DebuggerMainWnd::saveSettings(KSharedConfigPtr config)
     }
 
     config->group(OutputWindowGroup).writeEntry(TermCmdStr, m_outputTermCmdStr);
-    config->group(DebuggerGroup).writeEntry(DebuggerCmdStr, m_debuggerCmdStr);
+    KConfigGroup dg(config->group(DebuggerGroup));
+    dg.writeEntry(DebuggerCmdStr, m_debuggerCmdStr);
+    dg.writeEntry(PipelineDepth, m_pipelineDepth);
+    dg.writeEntry(ShallowLocals, m_shallowLocals);
 
     KConfigGroup pg(config->group(PreferencesGroup));
     pg.writeEntry(PopForeground, m_popForeground);
@@ -497,7 +538,18 @@ void DebuggerMainWnd::restoreSettings(KSharedConfigPtr config)
     setTerminalCmd(og.readEntry(TermCmdStr, defaultTermCmdStr));
     m_outputTermKeepScript = og.readEntry(KeepScript);
 
-    setDebuggerCmdStr(config->group(DebuggerGroup).readEntry(DebuggerCmdStr));
+    KConfigGroup dg(config->group(DebuggerGroup));
+    setDebuggerCmdStr(dg.readEntry(DebuggerCmdStr));
+    /*
+     * The number of commands that are sent to the debugger in advance;
+     * 1 sends one command at a time.
+     */
+    m_pipelineDepth = dg.readEntry(PipelineDepth, 1);
+    /*
+     * Whether local variables are listed without the members of structs
+     * and arrays, which are then fetched when they are expanded.
+     */
+    m_shallowLocals = dg.readEntry(ShallowLocals, false);
 
     KConfigGroup pg(config->group(PreferencesGroup));
     m_popForeground = pg.readEntry(PopForeground, false);
@@ -525,10 +577,10 @@ void DebuggerMainWnd::updateUI()
     m_coreDumpAction->setEnabled(m_debugger->canStart());
     m_closeAction->setEnabled(m_filesWindow->hasWindows());
     m_reloadAction->setEnabled(m_filesWindow->hasWindows());
-    m_stepIntoAction->setEnabled(m_debugger->canSingleStep());
-    m_stepIntoIAction->setEnabled(m_debugger->canSingleStep());
-    m_stepOverAction->setEnabled(m_debugger->canSingleStep());
-    m_stepOverIAction->setEnabled(m_debugger->canSingleStep());
+    m_stepIntoAction->setEnabled(m_debugger->canStep());
+    m_stepIntoIAction->setEnabled(m_debugger->canStep());
+    m_stepOverAction->setEnabled(m_debugger->canStep());
+    m_stepOverIAction->setEnabled(m_debugger->canStep());
     m_stepOutAction->setEnabled(m_debugger->canSingleStep());
     m_toCursorAction->setEnabled(m_debugger->canSingleStep());
     m_execMovePCAction->setEnabled(m_debugger->canSingleStep());
@@ -627,6 +679,8 @@ void DebuggerMainWnd::makeDefaultLayout()
     tabifyDockWidget(dockParent(m_registers), dockParent(m_bpTable));
     tabifyDockWidget(dockParent(m_bpTable), dockParent(m_ttyWindow));
     tabifyDockWidget(dockParent(m_ttyWindow), dockParent(m_btWindow));
+    tabifyDockWidget(dockParent(m_btWindow), dockParent(m_perfWindow));
+    dockParent(m_perfWindow)->setVisible(false);
     tabifyDockWidget(dockParent(m_threads), dockParent(m_watches));
     dockParent(m_localVariables)->setVisible(true);
     dockParent(m_ttyWindow)->setVisible(true);
@@ -719,7 +773,9 @@ bool DebuggerMainWnd::startDriver(const QString& executable, QString lang)
 	KMessageBox::information(this, i18n("XSL debugging is no longer supported and will be removed in a future version of KDbg"));
     }
 
-    driver->setLogFileName(m_transcriptFile);
+    driver->setLogFileName(m_transcriptFile, m_transcriptMaxSize);
+    driver->setPipelineDepth(m_pipelineDepth);
+    driver->setShallowLocals(m_shallowLocals);
 
     bool success = m_debugger->debugProgram(executable, driver);
 
@@ -754,6 +810,7 @@ DebuggerDriver* DebuggerMainWnd::driverFromLang(QString lang)
 	// the following are actually driver names
 	{ "gdb",     "gdb",     1 },
 	{ "xsldbg",  "xsldbg",  2 },
+	{ "gdbm",    "gdbmi",   4 },
     };
     const int N = sizeof(langs)/sizeof(langs[0]);
 
@@ -786,6 +843,13 @@ DebuggerDriver* DebuggerMainWnd::driverFromLang(QString lang)
     case 2:
 	driver = new XsldbgDriver;
 	break;
+    case 4:
+	{
+	    GdbMiDriver* gdb = new GdbMiDriver;
+	    gdb->setDefaultInvocation(m_debuggerCmdStr);
+	    driver = gdb;
+	}
+	break;
     default:
 	// unknown language
 	break;
@@ -824,11 +888,12 @@ void DebuggerMainWnd::overrideProgramArguments(const QString& args)
     m_debugger->overrideProgramArguments(args);
 }
 
-void DebuggerMainWnd::setTranscript(const QString& name)
+void DebuggerMainWnd::setTranscript(const QString& name, qint64 maxSize)
 {
     m_transcriptFile = name;
+    m_transcriptMaxSize = maxSize;
     if (m_debugger != 0 && m_debugger->driver() != 0)
-	m_debugger->driver()->setLogFileName(m_transcriptFile);
+	m_debugger->driver()->setLogFileName(m_transcriptFile, m_transcriptMaxSize);
 }
 
 void DebuggerMainWnd::setAttachPid(const QString& pid)
@@ -973,6 +1038,8 @@ QString DebuggerMainWnd::createOutputWindow()
 {
     // create a name for a fifo
     QString fifoName = QString::asprintf("/tmp/kdbgttywin%05d", ::getpid());
+    if (m_sessionNo > 0)
+	fifoName += QString::asprintf(".%d", m_sessionNo);
 
     // create a fifo that will pass in the tty name
     QFile::remove(fifoName);		// remove remnants
@@ -1192,6 +1259,18 @@ void DebuggerMainWnd::slotFileOpen()
     }
 }
 
+void DebuggerMainWnd::slotFileNewWindow()
+{
+    DebuggerMainWnd* wnd = new DebuggerMainWnd;
+    // each debugger writes its own transcript
+    if (!m_transcriptFile.isEmpty()) {
+	wnd->setTranscript(m_transcriptFile + QString::asprintf(".%d", wnd->m_sessionNo),
+			   m_transcriptMaxSize);
+    }
+    wnd->m_lastDirectory = m_lastDirectory;
+    wnd->show();
+}
+
 void DebuggerMainWnd::slotFileExe()
 {
     if (m_debugger->isIdle())
@@ -25,6 +25,7 @@ class ExprWnd;
 class BreakpointTable;
 class ThreadList;
 class MemoryWindow;
+class PerfWindow;
 class TTYWindow;
 class WatchWindow;
 class KDebugger;
@@ -41,9 +42,10 @@ public:
     bool debugProgram(const QString& exe, const QString& lang);
 
     /**
-     * Specifies the file where to write the transcript.
+     * Specifies the file where to write the transcript. If \a maxSize is
+     * not zero, the file is rotated when it grows larger.
      */
-    void setTranscript(const QString& name);
+    void setTranscript(const QString& name, qint64 maxSize = 0);
     /**
      * Specifies the process to attach to after the program is loaded.
      */
@@ -76,6 +78,7 @@ protected:
     TTYWindow* m_ttyWindow;
     ThreadList* m_threads;
     MemoryWindow* m_memoryWindow;
+    PerfWindow* m_perfWindow;
 
     QTimer m_backTimer;
 
@@ -95,6 +98,7 @@ protected:
     QAction* m_ttyWindowAction;
     QAction* m_threadsAction;
     QAction* m_memoryWindowAction;
+    QAction* m_perfWindowAction;
     QAction* m_runAction;
     QAction* m_stepIntoAction;
     QAction* m_stepOverAction;
@@ -125,9 +129,13 @@ protected:
 			const char* slot, const char* name);
 
     // the debugger proper
+    int m_sessionNo;			/* distinguishes the windows of this process */
     QString m_debuggerCmdStr;
     KDebugger* m_debugger;
+    int m_pipelineDepth;		/* commands sent to gdb in advance */
+    bool m_shallowLocals;		/* locals without members of structs */
     QString m_transcriptFile;		/* where gdb dialog is logged */
+    qint64 m_transcriptMaxSize;		/* when the transcript is rotated */
 
     /**
      * Starts to debug the specified program using the specified language
@@ -197,6 +205,7 @@ public slots:
     void slotEditValue();
 
     void slotFileOpen();
+    void slotFileNewWindow();
     void slotFileExe();
     void slotFileCore();
     void slotFileGlobalSettings();
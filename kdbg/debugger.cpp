@@ -12,6 +12,7 @@
 #include "pgmsettings.h"
 #include <QFileInfo>
 #include <QListWidget>
+#include <QScrollBar>
 #include <QApplication>
 #include <QCryptographicHash>
 #include <QStandardPaths>
@@ -23,8 +24,20 @@
 #include <stdlib.h>			/* strtol, atoi */
 #include <unistd.h>			/* sleep(3) */
 #include <algorithm>
+#include <vector>
 #include "mydebug.h"
 
+// how many steps may be queued behind the one that is executing
+static const int maxPendingSteps = 2;
+// how long stepping must pause until all views are refreshed (ms)
+static const int stepRefreshDelay = 50;
+
+/*
+ * The backtrace fetches this many frames at a time. More are fetched when
+ * the list is scrolled to its end.
+ */
+static const int btWindowSize = 100;
+
 /**
  * Returns expression value for a tooltip.
  */
@@ -42,6 +55,7 @@ QString formatPopupValue(const T* v)
 	// no value: we use some hint
         switch (v->m_varKind) {
         case VarTree::VKstruct:
+        case VarTree::VKlazy:
             tip += "{...}";
             break;
         case VarTree::VKarray:
@@ -68,13 +82,28 @@ KDebugger::KDebugger(QWidget* parent,
 	m_programActive(false),
 	m_programRunning(false),
 	m_sharedLibsListed(false),
+	m_stepping(false),
+	m_pendingSteps(0),
+	m_markerIsPC(false),
+	m_deferredStopFlags(0),
 	m_typeTable(0),
+	m_btFrames(btWindowSize),
+	m_btMore(false),
 	m_programConfig(0),
 	m_d(0),
 	m_localVariables(*localVars),
 	m_watchVariables(*watchVars),
 	m_btWindow(*backtrace)
 {
+    for (int i = 0; i < DVcount; i++) {
+	m_viewVisible[i] = true;
+	m_viewStale[i] = false;
+    }
+
+    m_stepRefreshTimer.setSingleShot(true);
+    m_stepRefreshTimer.setInterval(stepRefreshDelay);
+    connect(&m_stepRefreshTimer, SIGNAL(timeout()), SLOT(slotStepRefresh()));
+
     connect(&m_localVariables, SIGNAL(itemExpanded(QTreeWidgetItem*)),
 	    SLOT(slotExpanding(QTreeWidgetItem*)));
     connect(&m_watchVariables, SIGNAL(itemExpanded(QTreeWidgetItem*)),
@@ -85,6 +114,8 @@ KDebugger::KDebugger(QWidget* parent,
 	    SLOT(slotValueEdited(VarTree*, const QString&)));
 
     connect(&m_btWindow, SIGNAL(currentRowChanged(int)), this, SLOT(gotoFrame(int)));
+    connect(m_btWindow.verticalScrollBar(), SIGNAL(valueChanged(int)),
+	    SLOT(slotBacktraceScrolled(int)));
 
     emit updateUI();
 }
@@ -97,6 +128,7 @@ KDebugger::~KDebugger()
 	delete m_programConfig;
     }
 
+    m_typeCache.save();
     delete m_typeTable;
 }
 
@@ -142,6 +174,8 @@ bool KDebugger::debugProgram(const QString& name,
     // wire up the driver
     connect(driver, SIGNAL(activateFileLine(const QString&,int,const DbgAddr&)),
 	    this, SIGNAL(activateFileLine(const QString&,int,const DbgAddr&)));
+    connect(driver, SIGNAL(activateFileLine(const QString&,int,const DbgAddr&)),
+	    SLOT(slotLocationMarker(const QString&,int,const DbgAddr&)));
     connect(driver, SIGNAL(finished(int, QProcess::ExitStatus)),
 	    SLOT(gdbExited()));
     connect(driver, SIGNAL(commandReceived(CmdQueueItem*,const char*)),
@@ -184,8 +218,9 @@ bool KDebugger::debugProgram(const QString& name,
     // set remote target
     if (!m_remoteDevice.isEmpty()) {
 	m_d->executeCmd(DCtargetremote, m_remoteDevice);
-	m_d->queueCmd(DCbt);
-	m_d->queueCmd(DCinfothreads);
+	m_d->queueCmd(DCbt, m_btFrames);
+	if (wantViewUpdate(DVthreads))
+	    m_d->queueCmd(DCinfothreads);
 	m_d->queueCmdAgain(DCframe, 0);
 	m_programActive = true;
 	m_haveExecutable = true;
@@ -194,6 +229,8 @@ bool KDebugger::debugProgram(const QString& name,
     // create a type table
     m_typeTable = new ProgramTypeTable;
     m_sharedLibsListed = false;
+    m_typeCache.load(name);
+    m_disassCache.load(name);
 
     emit updateUI();
 
@@ -238,6 +275,7 @@ void KDebugger::programRun()
 	m_d->executeCmdOnce(DCrun);
 	m_corefile = QString();
 	m_programActive = true;
+	m_btFrames = btWindowSize;
     }
     m_programRunning = true;
 }
@@ -259,13 +297,14 @@ void KDebugger::programRunAgain()
     if (canSingleStep()) {
 	m_d->executeCmdOnce(DCrun);
 	m_corefile = QString();
+	m_btFrames = btWindowSize;
 	m_programRunning = true;
     }
 }
 
 void KDebugger::programStep()
 {
-    if (canSingleStep()) {
+    if (beginStep()) {
 	m_d->executeCmdOnce(DCstep);
 	m_programRunning = true;
     }
@@ -273,7 +312,7 @@ void KDebugger::programStep()
 
 void KDebugger::programNext()
 {
-    if (canSingleStep()) {
+    if (beginStep()) {
 	m_d->executeCmdOnce(DCnext);
 	m_programRunning = true;
     }
@@ -281,7 +320,7 @@ void KDebugger::programNext()
 
 void KDebugger::programStepi()
 {
-    if (canSingleStep()) {
+    if (beginStep()) {
 	m_d->executeCmdOnce(DCstepi);
 	m_programRunning = true;
     }
@@ -289,12 +328,32 @@ void KDebugger::programStepi()
 
 void KDebugger::programNexti()
 {
-    if (canSingleStep()) {
+    if (beginStep()) {
 	m_d->executeCmdOnce(DCnexti);
 	m_programRunning = true;
     }
 }
 
+/*
+ * Decides whether a step command can be issued. While a step is still
+ * executing, a few more are queued behind it, but not too many, so that
+ * the program does not run far ahead after the key was released.
+ */
+bool KDebugger::beginStep()
+{
+    if (canSingleStep()) {
+	// a refresh that is still waiting would be stale right away
+	m_stepRefreshTimer.stop();
+	m_stepping = true;
+	return true;
+    }
+    if (canStep()) {
+	m_pendingSteps++;
+	return true;
+    }
+    return false;
+}
+
 void KDebugger::programFinish()
 {
     if (canSingleStep()) {
@@ -580,6 +639,7 @@ bool KDebugger::deleteBreakpoint(BrkptIterator bp)
 	}
 	m_d->executeCmd(DCdelete, bp->id);
     } else {
+	unindexBreakpoint(bp);
 	m_brkpts.erase(bp);
 	emit breakpointsChanged();
     }
@@ -591,6 +651,13 @@ bool KDebugger::canSingleStep()
     return isReady() && m_programActive && !m_programRunning;
 }
 
+bool KDebugger::canStep()
+{
+    return canSingleStep() ||
+	(m_d != 0 && m_programRunning && m_stepping &&
+	 m_pendingSteps < maxPendingSteps);
+}
+
 bool KDebugger::canChangeBreakpoints()
 {
     return isReady() && !m_programRunning;
@@ -699,6 +766,8 @@ void KDebugger::gdbExited()
     }
 
     // erase types
+    m_typeCache.save();
+    m_disassCache.close();
     delete m_typeTable;
     m_typeTable = 0;
 
@@ -720,6 +789,7 @@ void KDebugger::gdbExited()
     m_attachedPid = QString();		/* we are no longer attached to a process */
     m_ttyLevel = ttyFull;
     m_brkpts.clear();
+    rebuildBreakpointIndex();
 
     // erase PC
     emit updatePC(QString(), -1, DbgAddr(), 0);
@@ -1026,6 +1096,10 @@ void KDebugger::parse(CmdQueueItem* cmd, const char* output)
     ASSERT(cmd != 0);			/* queue mustn't be empty */
 
     TRACE(QString(__PRETTY_FUNCTION__) + " parsing " + output);
+    TRACE_SPAN("KDebugger::parse");
+
+    // only a stop can set this, see handleRunCommands()
+    m_markerIsPC = false;
 
     switch (cmd->m_cmd) {
     case DCtargetremote:
@@ -1135,12 +1209,17 @@ void KDebugger::parse(CmdQueueItem* cmd, const char* output)
 	updateAllExprs();
 	break;
     case DCbt:
-	handleBacktrace(output);
-	updateAllExprs();
+	handleBacktrace(cmd, output);
+	// more frames of the same stack do not change the variables
+	if (!cmd->m_byUser)
+	    updateAllExprs();
 	break;
     case DCprint:
 	handlePrint(cmd, output);
 	break;
+    case DCprintBatch:
+	handlePrintBatch(cmd, output);
+	break;
     case DCprintPopup:
 	handlePrintPopup(cmd, output);
 	break;
@@ -1164,6 +1243,9 @@ void KDebugger::parse(CmdQueueItem* cmd, const char* output)
     case DCkill:
     case DCdetach:
 	m_programRunning = m_programActive = false;
+	m_stepping = false;
+	m_pendingSteps = 0;
+	m_stepRefreshTimer.stop();
 	// erase PC
 	emit updatePC(QString(), -1, DbgAddr(), 0);
 	break;
@@ -1220,6 +1302,19 @@ void KDebugger::backgroundUpdate()
      */
     if (m_programActive)
 	evalExpressions();
+
+    /*
+     * If nothing more is to be done, the views are up to date. Find out
+     * how long it takes until they are painted.
+     */
+    if (m_d->isIdle() && m_d->perfStats().endStop())
+	QTimer::singleShot(0, this, SLOT(slotUIUpdated()));
+}
+
+void KDebugger::slotUIUpdated()
+{
+    if (m_d != 0)
+	m_d->perfStats().uiUpdated();
 }
 
 void KDebugger::handleRunCommands(const char* output)
@@ -1229,6 +1324,13 @@ void KDebugger::handleRunCommands(const char* output)
     emit updateStatusMessage();
 
     m_programActive = flags & DebuggerDriver::SFprogramActive;
+    if (m_programActive)
+	m_d->perfStats().beginStop();
+
+    bool stepped = m_stepping;
+    m_stepping = false;
+    if (!m_programActive)
+	m_pendingSteps = 0;
 
     // refresh files if necessary
     if (flags & DebuggerDriver::SFrefreshSource) {
@@ -1250,17 +1352,6 @@ void KDebugger::handleRunCommands(const char* output)
 	}
     }
 
-    /*
-     * If we stopped at a breakpoint, we must update the breakpoint list
-     * because the hit count changes. Also, if the breakpoint was temporary
-     * it would go away now.
-     */
-    if ((flags & (DebuggerDriver::SFrefreshBreak|DebuggerDriver::SFrefreshSource)) ||
-	stopMayChangeBreakList())
-    {
-	m_d->queueCmd(DCinfobreak);
-    }
-
     /*
      * If we haven't listed the shared libraries yet, do so. We must do
      * this before we emit any commands that list variables, since the type
@@ -1271,23 +1362,92 @@ void KDebugger::handleRunCommands(const char* output)
 	m_d->executeCmd(DCinfosharedlib);
     }
 
-    // get the backtrace if the program is running
-    if (m_programActive) {
-	m_d->queueCmd(DCbt);
-    } else {
+    if (!m_programActive) {
 	// program finished: erase PC
 	emit updatePC(QString(), -1, DbgAddr(), 0);
 	// dequeue any commands in the queues
 	m_d->flushCommands();
+	m_deferredStopFlags = 0;
+	m_stepRefreshTimer.stop();
+    }
+    else if (stepped && m_pendingSteps > 0)
+    {
+	/*
+	 * The next step is already queued: the program continues right
+	 * away. Show only where it is; the driver reports the location
+	 * after we return.
+	 */
+	m_pendingSteps--;
+	m_stepping = true;
+	m_markerIsPC = true;
+	m_deferredStopFlags |= flags;
+	return;
+    }
+    else if (stepped)
+    {
+	// more steps may follow; refresh only when they pause
+	m_markerIsPC = true;
+	m_deferredStopFlags |= flags;
+	m_stepRefreshTimer.start();
+    }
+    else
+    {
+	queueStopRefresh(flags);
+    }
+
+    m_programRunning = false;
+    emit programStopped();
+}
+
+/*
+ * Retrieves what may have changed when the program stopped.
+ */
+void KDebugger::queueStopRefresh(uint flags)
+{
+    flags |= m_deferredStopFlags;
+    m_deferredStopFlags = 0;
+    m_stepRefreshTimer.stop();
+
+    /*
+     * If we stopped at a breakpoint, we must update the breakpoint list
+     * because the hit count changes. Also, if the breakpoint was temporary
+     * it would go away now.
+     */
+    if ((flags & (DebuggerDriver::SFrefreshBreak|DebuggerDriver::SFrefreshSource)) ||
+	stopMayChangeBreakList())
+    {
+	m_d->queueCmd(DCinfobreak);
     }
 
+    // get the backtrace; if more frames were requested, they update the PC now
+    CmdQueueItem* btCmd = m_d->queueCmd(DCbt, m_btFrames);
+    btCmd->m_byUser = false;
+
     /* Update threads list */
-    if (m_programActive && (flags & DebuggerDriver::SFrefreshThreads)) {
+    if ((flags & DebuggerDriver::SFrefreshThreads) &&
+	wantViewUpdate(DVthreads))
+    {
 	m_d->queueCmd(DCinfothreads);
     }
+}
 
-    m_programRunning = false;
-    emit programStopped();
+void KDebugger::slotStepRefresh()
+{
+    if (m_d != 0 && m_programActive && !m_programRunning)
+	queueStopRefresh(0);
+}
+
+/*
+ * During fast stepping, the location that the driver reports after a stop
+ * is the only information about where the program is.
+ */
+void KDebugger::slotLocationMarker(const QString& file, int lineNo,
+				   const DbgAddr& address)
+{
+    if (m_markerIsPC) {
+	m_markerIsPC = false;
+	emit updatePC(file, lineNo, address, 0);
+    }
 }
 
 void KDebugger::slotInferiorRunning()
@@ -1304,10 +1464,11 @@ void KDebugger::updateAllExprs()
     m_d->queueCmd(DCinfolocals);
 
     // retrieve registers
-    m_d->queueCmd(DCinforegisters);
+    if (wantViewUpdate(DVregisters))
+	m_d->queueCmd(DCinforegisters);
 
     // get new memory dump
-    if (!m_memoryStartExpression.isEmpty()) {
+    if (!m_memoryStartExpression.isEmpty() && wantViewUpdate(DVmemory)) {
 	queueMemoryDump(false, true);
     }
 
@@ -1372,15 +1533,21 @@ void KDebugger::updateProgEnvironment(const QString& args, const QString& wd,
 
 void KDebugger::handleLocals(const char* output)
 {
-    // retrieve old list of local variables
-    QStringList oldVars = m_localVariables.exprList();
-
     /*
      *  Get local variables.
      */
     std::list<ExprValue*> newVars;
     parseLocals(output, newVars);
 
+    /*
+     * Functions can have thousands of local variables; look them up by
+     * name so that matching old and new ones takes linear time.
+     */
+    QHash<QString, std::list<ExprValue*>::iterator> newByName;
+    newByName.reserve(int(newVars.size()));
+    for (std::list<ExprValue*>::iterator v = newVars.begin(); v != newVars.end(); ++v)
+	newByName.insert((*v)->m_name, v);
+
     /*
      * Clear any old VarTree item pointers, so that later we don't access
      * dangling pointers.
@@ -1390,27 +1557,32 @@ void KDebugger::handleLocals(const char* output)
     /*
      * Match old variables against new ones.
      */
-    for (QStringList::ConstIterator n = oldVars.begin(); n != oldVars.end(); ++n) {
+    std::vector<VarTree*> oldVars;
+    for (int i = 0; i < m_localVariables.topLevelItemCount(); i++)
+    {
+	VarTree* display = m_localVariables.topLevelItem(i);
 	// lookup this variable in the list of new variables
-	std::list<ExprValue*>::iterator v = newVars.begin();
-	while (v != newVars.end() && (*v)->m_name != *n)
-	    ++v;
-	if (v == newVars.end()) {
+	QHash<QString, std::list<ExprValue*>::iterator>::iterator n =
+		newByName.find(display->getText());
+	if (n == newByName.end()) {
 	    // old variable not in the new variables
-	    TRACE("old var deleted: " + *n);
-	    VarTree* v = m_localVariables.topLevelExprByName(*n);
-	    if (v != 0) {
-		m_localVariables.removeExpr(v);
-	    }
+	    oldVars.push_back(display);
 	} else {
 	    // variable in both old and new lists: update
-	    TRACE("update var: " + *n);
-	    m_localVariables.updateExpr(*v, *m_typeTable);
+	    TRACE("update var: " + display->getText());
+	    m_localVariables.updateExpr(display, **n, *m_typeTable);
 	    // remove the new variable from the list
-	    delete *v;
-	    newVars.erase(v);
+	    delete **n;
+	    newVars.erase(*n);
+	    newByName.erase(n);
 	}
     }
+    // remove from the end, which is cheaper for the tree widget
+    for (std::vector<VarTree*>::reverse_iterator v = oldVars.rbegin(); v != oldVars.rend(); ++v)
+    {
+	TRACE("old var deleted: " + (*v)->getText());
+	m_localVariables.removeExpr(*v);
+    }
     // insert all remaining new variables
     while (!newVars.empty())
     {
@@ -1427,29 +1599,24 @@ void KDebugger::parseLocals(const char* output, std::list<ExprValue*>& newVars)
     std::list<ExprValue*> vars;
     m_d->parseLocals(output, vars);
 
-    QString origName;			/* used in renaming variables */
+    /*
+     * When gdb prints local variables, those from the innermost block
+     * come first. We count how often each name was seen already to find
+     * duplicates (ie. variables that hide local variables from a
+     * surrounding block). We keep the name of the inner variable, but
+     * rename those from the outer block so that, when the value is
+     * updated in the window, the value of the variable that is
+     * _visible_ changes the color!
+     */
+    QHash<QString, int> depth;
     while (!vars.empty())
     {
 	ExprValue* variable = vars.front();
 	vars.pop_front();
-	/*
-	 * When gdb prints local variables, those from the innermost block
-	 * come first. We run through the list of already parsed variables
-	 * to find duplicates (ie. variables that hide local variables from
-	 * a surrounding block). We keep the name of the inner variable, but
-	 * rename those from the outer block so that, when the value is
-	 * updated in the window, the value of the variable that is
-	 * _visible_ changes the color!
-	 */
-	int block = 0;
-	origName = variable->m_name;
-	for (std::list<ExprValue*>::iterator v = newVars.begin(); v != newVars.end(); ++v) {
-	    if (variable->m_name == (*v)->m_name) {
-		// we found a duplicate, change name
-		block++;
-		QString newName = origName + " (" + QString().setNum(block) + ")";
-		variable->m_name = newName;
-	    }
+	int block = depth[variable->m_name]++;
+	if (block > 0) {
+	    // we found a duplicate, change name
+	    variable->m_name += " (" + QString().setNum(block) + ")";
 	}
 	newVars.push_back(variable);
     }
@@ -1477,6 +1644,32 @@ bool KDebugger::handlePrint(CmdQueueItem* cmd, const char* output)
     return true;
 }
 
+void KDebugger::handlePrintBatch(CmdQueueItem* cmd, const char* output)
+{
+    std::list<ExprValue*> values;
+    m_d->parsePrintBatch(output, values);
+
+    /*
+     * Watch expressions may have been removed since the command was
+     * queued, therefore, we look them up by name.
+     */
+    std::list<ExprValue*>::iterator v = values.begin();
+    for (std::list<QString>::iterator e = cmd->m_batchExprs.begin();
+	 e != cmd->m_batchExprs.end() && v != values.end(); ++e, ++v)
+    {
+	VarTree* exprItem = m_watchVariables.topLevelExprByName(*e);
+	if (exprItem == 0 || *v == 0)
+	    continue;
+	(*v)->m_name = exprItem->getText();
+	TRACE("update expr: " + exprItem->getText());
+	m_watchVariables.updateExpr(exprItem, *v, *m_typeTable);
+    }
+    for (v = values.begin(); v != values.end(); ++v)
+	delete *v;
+
+    evalExpressions();			/* enqueue dereferenced pointers */
+}
+
 bool KDebugger::handlePrintPopup(CmdQueueItem* cmd, const char* output)
 {
     ExprValue* value = m_d->parsePrintExpr(output, false);
@@ -1515,7 +1708,7 @@ bool KDebugger::handlePrintDeref(CmdQueueItem* cmd, const char* output)
 	variable->m_name = addr;
 	variable->m_nameKind = VarTree::NKaddress;
 
-	dummyParent->m_child = variable;
+	dummyParent->appendChild(variable);
 	// expand the first level for convenience
 	variable->m_initiallyExpanded = true;
 	TRACE("update ptr: " + cmd->m_expr->getText());
@@ -1529,32 +1722,119 @@ bool KDebugger::handlePrintDeref(CmdQueueItem* cmd, const char* output)
 }
 
 // parse the output of bt
-void KDebugger::handleBacktrace(const char* output)
+/*
+ * Returns the function of a frame as printed in the backtrace, but without
+ * the arguments, whose values change from call to call.
+ */
+static QString frameScope(const QString& func)
 {
-    m_btWindow.clear();
+    int nest = 0;
+    for (int i = 1; i < func.length(); i++) {
+	if (func[i] == '<')
+	    nest++;
+	else if (func[i] == '>')
+	    nest--;
+	else if (func[i] == '(' && func[i-1] == ' ' && nest == 0)
+	    return func.left(i-1);
+    }
+    return func;
+}
 
+void KDebugger::handleBacktrace(CmdQueueItem* cmd, const char* output)
+{
     std::list<StackFrame> stack;
     m_d->parseBackTrace(output, stack);
 
-    if (!stack.empty()) {
-	std::list<StackFrame>::iterator frm = stack.begin();
+    // if the user scrolled for more frames, the selected frame stays
+    bool extending = cmd->m_byUser;
+    if (!extending) {
+	m_btWindow.setCurrentRow(-1);
+	m_scope = QString();
+    }
+
+    // fewer frames than requested are the whole stack
+    m_btMore = int(stack.size()) >= m_btFrames;
+    if (stack.empty())
+	m_btFrames = btWindowSize;
+
+    if (!stack.empty() && !extending) {
 	// first frame must set PC
 	// note: frm->lineNo is zero-based
-	emit updatePC(frm->fileName, frm->lineNo, frm->address, frm->frameNo);
+	StackFrame& frm = stack.front();
+	emit updatePC(frm.fileName, frm.lineNo, frm.address, frm.frameNo);
+    }
 
-	for (; frm != stack.end(); ++frm) {
-	    QString func;
-	    if (frm->var != 0)
-		func = frm->var->m_name;
-	    else
-		func = frm->fileName + ":" + QString().setNum(frm->lineNo+1);
-        
- 	    m_btWindow.addItem(func);
-	    TRACE("frame " + func + " (" + frm->fileName + ":" +
-		  QString().setNum(frm->lineNo+1) + ")");
+    /*
+     * Only the items of frames that are different are replaced. After a
+     * step, this is usually just the innermost frame.
+     */
+    m_frameScopes.clear();
+    int row = 0;
+    bool outerChanged = int(stack.size()) < m_btWindow.count();
+    for (std::list<StackFrame>::iterator frm = stack.begin(); frm != stack.end(); ++frm, ++row)
+    {
+	QString func;
+	if (frm->var != 0) {
+	    func = frm->var->m_name;
+	    // static functions in different files can have the same name
+	    m_frameScopes.push_back(frm->fileName + ":" + frameScope(func));
+	} else {
+	    func = frm->fileName + ":" + QString().setNum(frm->lineNo+1);
+	    m_frameScopes.push_back(QString());
+	}
+
+	if (row < m_btWindow.count()) {
+	    QListWidgetItem* item = m_btWindow.item(row);
+	    if (item->text() != func) {
+		item->setText(func);
+		outerChanged = outerChanged || row > 0;
+	    }
+	} else {
+	    m_btWindow.addItem(func);
 	}
+	TRACE("frame " + func + " (" + frm->fileName + ":" +
+	      QString().setNum(frm->lineNo+1) + ")");
+    }
+    if (row == 0) {
+	m_btWindow.clear();
+    } else {
+	while (m_btWindow.count() > row)
+	    delete m_btWindow.takeItem(m_btWindow.count()-1);
     }
 
+    /*
+     * The frames that the user scrolled to are fetched again after each
+     * stop only as long as the stack stays the same outside the innermost
+     * frame. Otherwise, we start over with the first window.
+     */
+    if (!extending && outerChanged && m_btFrames > btWindowSize) {
+	m_btFrames = btWindowSize;
+	m_btMore = m_btWindow.count() > btWindowSize;
+	while (m_btWindow.count() > btWindowSize)
+	    delete m_btWindow.takeItem(m_btWindow.count()-1);
+	while (m_frameScopes.size() > btWindowSize)
+	    m_frameScopes.removeLast();
+    }
+    if (!extending && !m_frameScopes.isEmpty())
+	m_scope = m_frameScopes.front();
+}
+
+/*
+ * gdb lists the frames of the stack only from the innermost frame on.
+ * When the end of the list comes into view, the frames are requested
+ * again including the next window.
+ */
+void KDebugger::slotBacktraceScrolled(int value)
+{
+    if (!m_btMore || value < m_btWindow.verticalScrollBar()->maximum())
+	return;
+    if (m_d == 0 || !m_programActive || m_programRunning)
+	return;
+
+    m_btMore = false;
+    m_btFrames += btWindowSize;
+    CmdQueueItem* cmd = m_d->queueCmd(DCbt, m_btFrames);
+    cmd->m_byUser = true;
 }
 
 void KDebugger::gotoFrame(int frame)
@@ -1573,6 +1853,7 @@ void KDebugger::handleFrameChange(const char* output)
     int lineNo;
     DbgAddr address;
     if (m_d->parseFrameChange(output, frameNo, fileName, lineNo, address)) {
+	m_scope = m_frameScopes.value(frameNo);
 	/* lineNo can be negative here if we can't find a file name */
 	emit updatePC(fileName, lineNo, address, frameNo);
     } else {
@@ -1586,12 +1867,39 @@ void KDebugger::evalExpressions()
     //   watch expressions
     //   pointers in local variables
     //   pointers in watch expressions
+    //   members of structs and arrays in local variables
+    //   members of structs and arrays in watch expressions
+    //   ranges of arrays in local variables
+    //   ranges of arrays in watch expressions
+    //   lengths of arrays in local variables
+    //   lengths of arrays in watch expressions
     //   types in local variables
     //   types in watch expressions
     //   struct members in local variables
     //   struct members in watch expressions
     VarTree* exprItem = 0;
-    if (!m_watchEvalExpr.empty())
+    if (m_watchEvalExpr.size() > 1 && m_d->canPrintBatch())
+    {
+	// evaluate all watch expressions with a single command
+	std::list<QString> exprs;
+	QString exprList;
+	for (; !m_watchEvalExpr.empty(); m_watchEvalExpr.pop_front())
+	{
+	    exprItem = m_watchVariables.topLevelExprByName(m_watchEvalExpr.front());
+	    if (exprItem != 0) {
+		exprs.push_back(exprItem->getText());
+		exprList += exprItem->getText() + '\n';
+	    }
+	}
+	if (!exprs.empty()) {
+	    CmdQueueItem* cmd = m_d->queueCmd(DCprintBatch, exprList);
+	    cmd->m_batchExprs = exprs;
+	    cmd->m_exprWnd = &m_watchVariables;
+	    return;
+	}
+	exprItem = 0;
+    }
+    else if (!m_watchEvalExpr.empty())
     {
 	QString expr = m_watchEvalExpr.front();
 	m_watchEvalExpr.pop_front();
@@ -1608,6 +1916,18 @@ void KDebugger::evalExpressions()
 		wnd = &widget; \
 		exprItem = widget.nextUpdatePtr(); \
 		if (exprItem != 0) goto pointer
+#define LAZY(widget) \
+		wnd = &widget; \
+		exprItem = widget.nextUpdateLazy(); \
+		if (exprItem != 0) goto lazy
+#define RANGE(widget) \
+		wnd = &widget; \
+		exprItem = widget.nextUpdateRange(); \
+		if (exprItem != 0) goto range
+#define ARRAY(widget) \
+		wnd = &widget; \
+		exprItem = widget.nextUpdateArray(); \
+		if (exprItem != 0) goto array
 #define STRUCT(widget) \
 		wnd = &widget; \
 		exprItem = widget.nextUpdateStruct(); \
@@ -1619,11 +1939,20 @@ void KDebugger::evalExpressions()
     repeat:
 	POINTER(m_localVariables);
 	POINTER(m_watchVariables);
+	LAZY(m_localVariables);
+	LAZY(m_watchVariables);
+	RANGE(m_localVariables);
+	RANGE(m_watchVariables);
+	ARRAY(m_localVariables);
+	ARRAY(m_watchVariables);
 	STRUCT(m_localVariables);
 	STRUCT(m_watchVariables);
 	TYPE(m_localVariables);
 	TYPE(m_watchVariables);
 #undef POINTER
+#undef LAZY
+#undef RANGE
+#undef ARRAY
 #undef STRUCT
 #undef TYPE
 	return;
@@ -1633,6 +1962,18 @@ void KDebugger::evalExpressions()
 	dereferencePointer(wnd, exprItem, false);
 	return;
 
+	lazy:
+	fetchMembers(wnd, exprItem, false);
+	return;
+
+	range:
+	fetchRange(wnd, exprItem, false);
+	return;
+
+	array:
+	determineArrayLength(wnd, exprItem);
+	return;
+
 	ustruct:
 	// paranoia
 	if (exprItem->m_type == 0 || exprItem->m_type == TypeInfo::unknownType())
@@ -1648,6 +1989,16 @@ void KDebugger::evalExpressions()
 	 */
 	if (exprItem->m_type != 0)
 	    goto repeat;
+	{
+	    // perhaps we learnt the type in an earlier session
+	    QString type;
+	    if (m_typeCache.findType(m_scope, exprItem->computeExpr(), type)) {
+		exprItem->m_typeFromCache = true;
+		if (applyType(wnd, exprItem, type))
+		    return;
+		goto repeat;
+	    }
+	}
 	determineType(wnd, exprItem);
     }
 }
@@ -1670,6 +2021,54 @@ void KDebugger::dereferencePointer(ExprWnd* wnd, VarTree* exprItem,
     cmd->m_exprWnd = wnd;
 }
 
+void KDebugger::fetchMembers(ExprWnd* wnd, VarTree* exprItem, bool immediate)
+{
+    QString expr = exprItem->computeExpr();
+    TRACE("fetching members: " + expr);
+    CmdQueueItem* cmd;
+    if (immediate) {
+	cmd = m_d->queueCmdPrio(DCprint, expr);
+    } else {
+	cmd = m_d->queueCmd(DCprint, expr);
+    }
+    // remember which expr this was
+    cmd->m_expr = exprItem;
+    cmd->m_exprWnd = wnd;
+}
+
+void KDebugger::fetchRange(ExprWnd* wnd, VarTree* exprItem, bool immediate)
+{
+    ASSERT(exprItem->m_nameKind == VarTree::NKrange);
+
+    int first, last;
+    if (!ExprWnd::rangeBounds(exprItem, first, last))
+	return;
+    QString expr = QString("(%1)[%2]@%3")
+		.arg(exprItem->computeExpr()).arg(first).arg(last-first+1);
+    TRACE("fetching range: " + expr);
+    CmdQueueItem* cmd;
+    if (immediate) {
+	cmd = m_d->queueCmdPrio(DCprint, expr);
+    } else {
+	cmd = m_d->queueCmd(DCprint, expr);
+    }
+    // remember which expr this was
+    cmd->m_expr = exprItem;
+    cmd->m_exprWnd = wnd;
+}
+
+void KDebugger::determineArrayLength(ExprWnd* wnd, VarTree* exprItem)
+{
+    ASSERT(exprItem->m_varKind == VarTree::VKarray);
+
+    // the length is part of the type
+    QString expr = exprItem->computeExpr();
+    TRACE("get length of: " + expr);
+    CmdQueueItem* cmd = m_d->queueCmd(DCfindType, expr);
+    cmd->m_expr = exprItem;
+    cmd->m_exprWnd = wnd;
+}
+
 void KDebugger::determineType(ExprWnd* wnd, VarTree* exprItem)
 {
     ASSERT(exprItem->m_varKind == VarTree::VKstruct);
@@ -1691,38 +2090,64 @@ void KDebugger::handleFindType(CmdQueueItem* cmd, const char* output)
     {
 	ASSERT(cmd != 0 && cmd->m_expr != 0);
 
-	const TypeInfo* info = m_typeTable->lookup(type);
-
-	if (info == 0) {
-	    /*
-	     * We've asked gdb for the type of the expression in
-	     * cmd->m_expr, but it returned a name we don't know. The base
-	     * class (and member) types have been checked already (at the
-	     * time when we parsed that particular expression). Now it's
-	     * time to derive the type from the base classes as a last
-	     * resort.
-	     */
-	    info = cmd->m_expr->inferTypeFromBaseClass();
-	    // if we found a type through this method, register an alias
-	    if (info != 0) {
-		TRACE("infered alias: " + type);
-		m_typeTable->registerAlias(type, info);
-	    }
-	}
-	if (info == 0) {
-            TRACE("unknown type "+type);
-	    cmd->m_expr->m_type = TypeInfo::unknownType();
-	} else {
-	    cmd->m_expr->m_type = info;
-	    /* since this node has a new type, we get its value immediately */
-	    evalInitialStructExpression(cmd->m_expr, cmd->m_exprWnd, false);
+	if (cmd->m_expr->m_varKind == VarTree::VKarray) {
+	    // the type of an array is like "int[1000]"
+	    int open = type.indexOf('[');
+	    int close = type.indexOf(']', open);
+	    bool ok = false;
+	    int length = open < 0 || close < 0 ? 0 :
+			 type.mid(open+1, close-open-1).toInt(&ok);
+	    if (ok)
+		cmd->m_exprWnd->insertRanges(cmd->m_expr, length);
+	    evalExpressions();
 	    return;
 	}
+
+	m_typeCache.addType(m_scope, cmd->m_expr->computeExpr(), type);
+	cmd->m_expr->m_typeFromCache = false;
+	if (applyType(cmd->m_exprWnd, cmd->m_expr, type))
+	    return;
     }
 
     evalExpressions();			/* queue more of them */
 }
 
+/*
+ * Assigns the type named \a type to \a var. Returns true if the evaluation
+ * of the struct value was queued.
+ */
+bool KDebugger::applyType(ExprWnd* wnd, VarTree* var, const QString& type)
+{
+    const TypeInfo* info = m_typeTable->lookup(type);
+
+    if (info == 0) {
+	/*
+	 * We've asked gdb for the type of the expression in var, but it
+	 * returned a name we don't know. The base class (and member)
+	 * types have been checked already (at the time when we parsed
+	 * that particular expression). Now it's time to derive the type
+	 * from the base classes as a last resort.
+	 */
+	QString base;
+	info = var->inferTypeFromBaseClass(&base);
+	// if we found a type through this method, register an alias
+	if (info != 0) {
+	    TRACE("infered alias: " + type);
+	    m_typeTable->registerAlias(type, info);
+	    m_typeCache.addAlias(type, base);
+	}
+    }
+    if (info == 0) {
+	TRACE("unknown type "+type);
+	var->m_type = TypeInfo::unknownType();
+	return false;
+    }
+    var->m_type = info;
+    /* since this node has a new type, we get its value immediately */
+    evalInitialStructExpression(var, wnd, false);
+    return true;
+}
+
 void KDebugger::handlePrintStruct(CmdQueueItem* cmd, const char* output)
 {
     VarTree* var = cmd->m_expr;
@@ -1769,6 +2194,23 @@ void KDebugger::handlePrintStruct(CmdQueueItem* cmd, const char* output)
      */
     ASSERT(var->m_exprIndex >= 0 && var->m_exprIndex <= typeInfoMaxExpr);
 
+    /*
+     * A block may declare a variable of the same name as one in another
+     * block, but of a different type. If a member of a type that we
+     * remembered from an earlier evaluation cannot be printed, the type
+     * is forgotten and asked for.
+     */
+    if (errorValue && !var->m_exprIndexUseGuard && var->m_typeFromCache)
+    {
+	TRACE("cached type failed: " + var->computeExpr());
+	m_typeCache.removeType(m_scope, var->computeExpr());
+	var->m_typeFromCache = false;
+	var->m_type = 0;
+	var->m_partialValue = QString();
+	determineType(cmd->m_exprWnd, var);
+	return;
+    }
+
     if (errorValue || !var->m_exprIndexUseGuard)
     {
 	// add current partValue (which might be the question marks)
@@ -1874,6 +2316,7 @@ void KDebugger::handleSharedLibs(const char* output)
 
     // get type libraries
     m_typeTable->loadLibTypes(m_sharedLibs);
+    m_typeCache.registerAliases(*m_typeTable);
 
     // hand over the QString data cmd
     m_d->setPrintQStringDataCmd(m_typeTable->printQStringDataCmd());
@@ -1887,10 +2330,30 @@ CmdQueueItem* KDebugger::loadCoreFile()
 void KDebugger::slotExpanding(QTreeWidgetItem* item)
 {
     VarTree* exprItem = static_cast<VarTree*>(item);
+    ExprWnd* wnd = static_cast<ExprWnd*>(item->treeWidget());
+
+    // evaluate what was skipped while the item was collapsed
+    if (wnd->resumeDeferred(exprItem) && m_programActive && m_d->isIdle()) {
+	evalExpressions();
+    }
+
+    // values that were listed without their members get them now
+    if (exprItem->m_varKind == VarTree::VKlazy) {
+	if (m_programActive)
+	    fetchMembers(wnd, exprItem, true);
+	return;
+    }
+
+    // the elements of a range of a long array are fetched on demand
+    if (exprItem->m_nameKind == VarTree::NKrange) {
+	if (wnd->expandRange(exprItem) && m_programActive)
+	    fetchRange(wnd, exprItem, true);
+	return;
+    }
+
     if (exprItem->m_varKind != VarTree::VKpointer) {
 	return;
     }
-    ExprWnd* wnd = static_cast<ExprWnd*>(item->treeWidget());
     dereferencePointer(wnd, exprItem, true);
 }
 
@@ -1988,6 +2451,7 @@ void KDebugger::newBreakpoint(CmdQueueItem* cmd, const char* output)
 		    minId = i->id;
 	    }
 	    bp->id = minId-1;
+	    indexBreakpoint(bp);
 	}
 	return;
     }
@@ -2005,11 +2469,15 @@ void KDebugger::newBreakpoint(CmdQueueItem* cmd, const char* output)
 	}
     }
 
+    // a new breakpoint is not in the index, yet
+    if (bp->id != 0)
+	unindexBreakpoint(bp);
     bp->id = id;
     bp->fileName = file;
     bp->lineNo = lineNo;
     if (!address.isEmpty())
 	bp->address = address;
+    indexBreakpoint(bp);
 }
 
 void KDebugger::updateBreakList(const char* output)
@@ -2046,6 +2514,7 @@ void KDebugger::updateBreakList(const char* output)
     }
 
     m_brkpts.swap(brks);
+    rebuildBreakpointIndex();
     emit breakpointsChanged();
 }
 
@@ -2064,30 +2533,30 @@ bool KDebugger::stopMayChangeBreakList() const
 KDebugger::BrkptIterator KDebugger::breakpointByFilePos(QString file, int lineNo,
 					   const DbgAddr& address)
 {
+    // the index knows only the base names
+    QHash<QString,std::multimap<int,int> >::const_iterator f =
+	m_brkptsByFile.constFind(QFileInfo(file).fileName());
+    if (f == m_brkptsByFile.constEnd())
+	return m_brkpts.end();
+    typedef std::multimap<int,int>::const_iterator LineIterator;
+    std::pair<LineIterator,LineIterator> range = f->equal_range(lineNo);
+
     // look for exact file name match
-    for (BrkptIterator bp = m_brkpts.begin(); bp != m_brkpts.end(); ++bp)
+    for (LineIterator i = range.first; i != range.second; ++i)
     {
-	if (bp->lineNo == lineNo &&
-	    bp->fileName == file &&
+	BrkptIterator bp = breakpointById(i->second);
+	if (bp->fileName == file &&
 	    (address.isEmpty() || bp->address == address))
 	{
 	    return bp;
 	}
     }
-    // not found, so try basename
-    file = QFileInfo(file).fileName();
-
-    for (BrkptIterator bp = m_brkpts.begin(); bp != m_brkpts.end(); ++bp)
+    // not found, so take one with the same base name
+    for (LineIterator i = range.first; i != range.second; ++i)
     {
-	// get base name of breakpoint's file
-	QString basename = QFileInfo(bp->fileName).fileName();
-
-	if (bp->lineNo == lineNo &&
-	    basename == file &&
-	    (address.isEmpty() || bp->address == address))
-	{
+	BrkptIterator bp = breakpointById(i->second);
+	if (address.isEmpty() || bp->address == address)
 	    return bp;
-	}
     }
 
     // not found
@@ -2096,14 +2565,72 @@ KDebugger::BrkptIterator KDebugger::breakpointByFilePos(QString file, int lineNo
 
 KDebugger::BrkptIterator KDebugger::breakpointById(int id)
 {
-    for (BrkptIterator bp = m_brkpts.begin(); bp != m_brkpts.end(); ++bp)
-    {
-	if (bp->id == id) {
-	    return bp;
+    return m_brkptById.value(id, m_brkpts.end());
+}
+
+std::vector<const Breakpoint*> KDebugger::breakpointsInFile(const QString& file) const
+{
+    std::vector<const Breakpoint*> brks;
+    QHash<QString,std::multimap<int,int> >::const_iterator f =
+	m_brkptsByFile.constFind(QFileInfo(file).fileName());
+    if (f == m_brkptsByFile.constEnd())
+	return brks;
+    brks.reserve(f->size());
+    for (std::multimap<int,int>::const_iterator i = f->begin(); i != f->end(); ++i)
+	brks.push_back(&*m_brkptById.value(i->second));
+    return brks;
+}
+
+/*
+ * Breakpoints without a file name are indexed only by id. If gdb lists
+ * several breakpoints with the same id, the first one is found by id like
+ * in a search of the list.
+ */
+void KDebugger::indexBreakpoint(BrkptIterator bp)
+{
+    if (m_brkptById.contains(bp->id))
+	return;
+    m_brkptById.insert(bp->id, bp);
+    if (!bp->fileName.isEmpty()) {
+	m_brkptsByFile[QFileInfo(bp->fileName).fileName()].insert(
+		std::make_pair(bp->lineNo, bp->id));
+    }
+}
+
+/*
+ * Must be called before the id or the location of the breakpoint changes.
+ */
+void KDebugger::unindexBreakpoint(BrkptIterator bp)
+{
+    QHash<int,BrkptIterator>::iterator i = m_brkptById.find(bp->id);
+    if (i == m_brkptById.end() || *i != bp)
+	return;
+    m_brkptById.erase(i);
+    if (bp->fileName.isEmpty())
+	return;
+
+    QHash<QString,std::multimap<int,int> >::iterator f =
+	m_brkptsByFile.find(QFileInfo(bp->fileName).fileName());
+    if (f == m_brkptsByFile.end())
+	return;
+    typedef std::multimap<int,int>::iterator LineIterator;
+    std::pair<LineIterator,LineIterator> range = f->equal_range(bp->lineNo);
+    for (LineIterator l = range.first; l != range.second; ++l) {
+	if (l->second == bp->id) {
+	    f->erase(l);
+	    break;
 	}
     }
-    // not found
-    return m_brkpts.end();
+    if (f->empty())
+	m_brkptsByFile.erase(f);
+}
+
+void KDebugger::rebuildBreakpointIndex()
+{
+    m_brkptById.clear();
+    m_brkptsByFile.clear();
+    for (BrkptIterator bp = m_brkpts.begin(); bp != m_brkpts.end(); ++bp)
+	indexBreakpoint(bp);
 }
 
 void KDebugger::slotValuePopup(const QString& expr)
@@ -2137,6 +2664,7 @@ void KDebugger::slotValuePopup(const QString& expr)
 void KDebugger::slotDisassemble(const QString& fileName, int lineNo)
 {
     if (m_haveExecutable) {
+	// the cached code is used only if the address range is unchanged
 	CmdQueueItem* cmd = m_d->queueCmdPrio(DCinfoline, fileName, lineNo);
 	cmd->m_fileName = fileName;
 	cmd->m_lineNo = lineNo;
@@ -2168,7 +2696,16 @@ void KDebugger::handleInfoLine(CmdQueueItem* cmd, const char* output)
     if (cmd->m_lineNo >= 0) {
 	// disassemble
 	if (m_d->parseInfoLine(output, addrFrom, addrTo)) {
+	    std::list<DisassembledCode> code;
+	    if (m_disassCache.find(disassContext(), cmd->m_fileName, cmd->m_lineNo,
+				   addrFrom, addrTo, code))
+	    {
+		emit disassembled(cmd->m_fileName, cmd->m_lineNo, code);
+		return;
+	    }
 	    // got the address range, now get the real code
+	    m_disassCache.addRange(disassContext(), cmd->m_fileName, cmd->m_lineNo,
+				   addrFrom, addrTo);
 	    CmdQueueItem* c = m_d->queueCmdPrio(DCdisassemble, addrFrom, addrTo);
 	    c->m_fileName = cmd->m_fileName;
 	    c->m_lineNo = cmd->m_lineNo;
@@ -2192,8 +2729,24 @@ void KDebugger::handleInfoTarget(const char* output)
 
 void KDebugger::handleDisassemble(CmdQueueItem* cmd, const char* output)
 {
-    emit disassembled(cmd->m_fileName, cmd->m_lineNo,
-		      m_d->parseDisassemble(output));
+    std::list<DisassembledCode> code = m_d->parseDisassemble(output);
+    m_disassCache.add(disassContext(), cmd->m_fileName, cmd->m_lineNo, code);
+    emit disassembled(cmd->m_fileName, cmd->m_lineNo, code);
+}
+
+/*
+ * The addresses of the code depend on the disassembly flavor and on
+ * whether the program was relocated. They can be the same in the next
+ * session only if the program is started by us or is not running; returns
+ * an empty string otherwise, which prevents caching. Even then, libraries
+ * may be loaded elsewhere; see handleInfoLine().
+ */
+QString KDebugger::disassContext() const
+{
+    if (!m_attachedPid.isEmpty() || !m_corefile.isEmpty() ||
+	!m_remoteDevice.isEmpty())
+	return QString();
+    return m_effectiveFlavor + (m_programActive ? "\trun" : "\tstatic");
 }
 
 void KDebugger::handleThreadList(const char* output)
@@ -2223,6 +2776,45 @@ void KDebugger::setMemoryExpression(const QString& start_memexpr, unsigned total
     }
 }
 
+/*
+ * Returns whether the contents of the view should be retrieved now. If the
+ * view is hidden, it is marked stale instead.
+ */
+bool KDebugger::wantViewUpdate(DataView view)
+{
+    if (m_viewVisible[view])
+	return true;
+    m_viewStale[view] = true;
+    return false;
+}
+
+void KDebugger::setViewVisible(DataView view, bool visible)
+{
+    m_viewVisible[view] = visible;
+    if (!visible || !m_viewStale[view])
+	return;
+
+    m_viewStale[view] = false;
+    // if the program is running, the view is updated when it stops
+    if (m_d == 0 || !m_programActive || m_programRunning)
+	return;
+
+    switch (view) {
+    case DVregisters:
+	m_d->queueCmd(DCinforegisters);
+	break;
+    case DVmemory:
+	if (!m_memoryStartExpression.isEmpty())
+	    queueMemoryDump(false, true);
+	break;
+    case DVthreads:
+	m_d->queueCmd(DCinfothreads);
+	break;
+    case DVcount:
+	break;
+    }
+}
+
 void KDebugger::queueMemoryDump(bool immediate, bool update)
 {
     if (update) {
@@ -7,11 +7,16 @@
 #ifndef DEBUGGER_H
 #define DEBUGGER_H
 
+#include <QHash>
 #include <QSet>
 #include <QStringList>
+#include <QTimer>
 #include <list>
 #include <map>
+#include <vector>
 #include "envvar.h"
+#include "typecache.h"
+#include "disasscache.h"
 #include "exprwnd.h"			/* some compilers require this */
 
 class ExprWnd;
@@ -274,6 +279,13 @@ public:
      */
     bool canSingleStep();
 
+    /**
+     * Tells whether step, next, stepi, or nexti can be invoked. Unlike
+     * canSingleStep(), this is also true while a step is executing and
+     * another one can be queued behind it.
+     */
+    bool canStep();
+
     /**
      * Tells whether a breakpoints can be set, deleted, enabled, or disabled.
      */
@@ -323,6 +335,11 @@ public:
     typedef std::list<Breakpoint>::const_iterator BrkptROIterator;
     BrkptROIterator breakpointsBegin() const { return m_brkpts.begin(); }
     BrkptROIterator breakpointsEnd() const { return m_brkpts.end(); }
+    /**
+     * Returns the breakpoints in the specified file ordered by line. Only
+     * the name part of \a file is compared, like SourceWindow does.
+     */
+    std::vector<const Breakpoint*> breakpointsInFile(const QString& file) const;
 
     const QString& executable() const { return m_executable; }
 
@@ -378,6 +395,13 @@ protected:
     
     std::list<QString> m_watchEvalExpr;	/* exprs to evaluate for watch window */
     std::list<Breakpoint> m_brkpts;
+    typedef std::list<Breakpoint>::iterator BrkptIterator;
+    /* the breakpoints by id, and the ids by file name (w/o directory) and line */
+    QHash<int,BrkptIterator> m_brkptById;
+    QHash<QString,std::multimap<int,int> > m_brkptsByFile;
+    void indexBreakpoint(BrkptIterator bp);
+    void unindexBreakpoint(BrkptIterator bp);
+    void rebuildBreakpointIndex();
     QString m_memoryExpression;		/* memory location to watch */
     unsigned m_memoryFormat;		/* how that output should look */
     unsigned m_memoryLength;         /* memory length to watch */
@@ -388,6 +412,8 @@ protected slots:
     void parse(CmdQueueItem* cmd, const char* output);
 protected:
     void handleRunCommands(const char* output);
+    void queueStopRefresh(uint flags);
+    bool beginStep();
     void updateAllExprs();
     void updateProgEnvironment(const QString& args, const QString& wd,
 			       const std::map<QString,EnvVar>& newVars,
@@ -395,9 +421,10 @@ protected:
     void parseLocals(const char* output, std::list<ExprValue*>& newVars);
     void handleLocals(const char* output);
     bool handlePrint(CmdQueueItem* cmd, const char* output);
+    void handlePrintBatch(CmdQueueItem* cmd, const char* output);
     bool handlePrintPopup(CmdQueueItem* cmd, const char* output);
     bool handlePrintDeref(CmdQueueItem* cmd, const char* output);
-    void handleBacktrace(const char* output);
+    void handleBacktrace(CmdQueueItem* cmd, const char* output);
     void handleFrameChange(const char* output);
     void handleFindType(CmdQueueItem* cmd, const char* output);
     void handlePrintStruct(CmdQueueItem* cmd, const char* output);
@@ -415,12 +442,15 @@ protected:
     void evalInitialStructExpression(VarTree* var, ExprWnd* wnd, bool immediate);
     void evalStructExpression(VarTree* var, ExprWnd* wnd, bool immediate);
     void dereferencePointer(ExprWnd* wnd, VarTree* var, bool immediate);
+    void fetchMembers(ExprWnd* wnd, VarTree* var, bool immediate);
+    void fetchRange(ExprWnd* wnd, VarTree* var, bool immediate);
+    void determineArrayLength(ExprWnd* wnd, VarTree* var);
     void determineType(ExprWnd* wnd, VarTree* var);
+    bool applyType(ExprWnd* wnd, VarTree* var, const QString& type);
     void queueMemoryDump(bool immediate, bool update);
     CmdQueueItem* loadCoreFile();
     void openProgramConfig(const QString& name);
 
-    typedef std::list<Breakpoint>::iterator BrkptIterator;
     BrkptIterator breakpointByFilePos(QString file, int lineNo,
 				    const DbgAddr& address);
     BrkptIterator breakpointById(int id);
@@ -440,6 +470,31 @@ protected:
     bool m_programActive;		/* is the program active (possibly halting in a brkpt)? */
     bool m_programRunning;		/* is the program executing (not stopped)? */
     bool m_sharedLibsListed;		/* do we know the shared libraries loaded by the prog? */
+
+    /**
+     * Fast stepping: When a step command is requested while the previous
+     * one is still executing (typically because the key is held down),
+     * it is queued right behind it. The stops in between only move the PC
+     * marker to the location reported by the driver. The backtrace, local
+     * variables etc. are retrieved only after stepping has paused for a
+     * moment.
+     */
+    bool m_stepping;			/* the running command is a step */
+    int m_pendingSteps;			/* steps queued behind the running one */
+    bool m_markerIsPC;			/* the next location from the driver is the PC */
+    uint m_deferredStopFlags;		/* collected from skipped refreshes */
+    QTimer m_stepRefreshTimer;
+
+    /**
+     * Views whose contents are retrieved each time the program stops.
+     * While a view is hidden, its contents are not retrieved, but marked
+     * stale; they are retrieved when the view is shown again.
+     */
+    enum DataView { DVregisters, DVmemory, DVthreads, DVcount };
+    bool m_viewVisible[DVcount];
+    bool m_viewStale[DVcount];
+    bool wantViewUpdate(DataView view);
+    void setViewVisible(DataView view, bool visible);
     QString m_executable;
     QString m_corefile;
     QString m_attachedPid;		/* user input of attaching to pid */
@@ -454,6 +509,13 @@ protected:
     QSet<QString> m_boolOptions;	/* boolean options */
     QStringList m_sharedLibs;		/* shared libraries used by program */
     ProgramTypeTable* m_typeTable;	/* known types used by the program */
+    TypeCache m_typeCache;		/* types learnt in earlier sessions */
+    QString m_scope;			/* function of the selected frame */
+    QStringList m_frameScopes;		/* functions of the frames */
+    int m_btFrames;			/* how many frames the backtrace shows */
+    bool m_btMore;			/* whether the stack has more frames */
+    DisassCache m_disassCache;		/* code of source lines */
+    QString disassContext() const;
     KConfig* m_programConfig;		/* program-specific settings (brkpts etc) */
     void saveProgramSettings();
     void restoreProgramSettings();
@@ -468,8 +530,12 @@ protected:
 protected slots:
     void gdbExited();
     void slotInferiorRunning();
+    void slotStepRefresh();
+    void slotLocationMarker(const QString& file, int lineNo, const DbgAddr& address);
     void backgroundUpdate();
+    void slotUIUpdated();
     void gotoFrame(int);
+    void slotBacktraceScrolled(int);
     void slotExpanding(QTreeWidgetItem*);
     void slotDeleteWatch();
     void slotValuePopup(const QString&);
@@ -478,6 +544,9 @@ protected slots:
 public slots:
     void setThread(int);
     void shutdown();
+    void setRegistersVisible(bool visible) { setViewVisible(DVregisters, visible); }
+    void setMemoryVisible(bool visible) { setViewVisible(DVmemory, visible); }
+    void setThreadsVisible(bool visible) { setViewVisible(DVthreads, visible); }
 
 signals:
     /**
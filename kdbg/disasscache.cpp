@@ -0,0 +1,290 @@
+/*
+ * Copyright Johannes Sixt
+ * This file is licensed under the GNU General Public License Version 2.
+ * See the file COPYING in the toplevel directory of the source directory.
+ */
+
+#include "disasscache.h"
+#include "typecache.h"			/* cacheNameForExe */
+#include "dbgdriver.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "mydebug.h"
+
+/*
+ * The file consists of records of this form:
+ *
+ *   @<tab>context<tab>file<tab>line
+ *   R<tab>from<tab>to
+ *   address<tab>code
+ *   ...
+ *   .
+ *
+ * Only records that are complete are used.
+ */
+static const char cacheHeader[] = "# kdbg disassembly cache 1\n";
+
+// when the file is loaded and is larger, it is rewritten to half the size
+static const qint64 maxCacheSize = 16*1024*1024;
+
+
+DisassCache::DisassCache() :
+	m_map(0),
+	m_mapSize(0)
+{
+}
+
+DisassCache::~DisassCache()
+{
+    close();
+}
+
+void DisassCache::unmap()
+{
+    if (m_map != 0) {
+	m_file.unmap(const_cast<uchar*>(m_map));
+	m_map = 0;
+	m_mapSize = 0;
+    }
+}
+
+void DisassCache::close()
+{
+    unmap();
+    m_file.close();
+    m_index.clear();
+    m_added.clear();
+    m_ranges.clear();
+}
+
+bool DisassCache::open()
+{
+    // several instances may append to the file at the same time
+    if (!m_file.open(QIODevice::ReadWrite | QIODevice::Append))
+	return false;
+    m_mapSize = m_file.size();
+    m_map = m_file.map(0, m_mapSize);
+    if (m_map == 0)
+	m_mapSize = 0;
+    return true;
+}
+
+/*
+ * Other instances may have mapped the file. Therefore, it is never
+ * truncated, but replaced by a new file.
+ */
+bool DisassCache::writeFile(const QString& fileName, const QByteArray& records)
+{
+    QSaveFile f(fileName);
+    if (!f.open(QIODevice::WriteOnly))
+	return false;
+    f.write(cacheHeader);
+    f.write(records);
+    return f.commit();
+}
+
+void DisassCache::load(const QString& executable)
+{
+    close();
+    QString name = cacheNameForExe(executable);
+    if (name.isEmpty())
+	return;
+
+    QString fileName = QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+			+ "/disassembly/" + name;
+    QDir().mkpath(QFileInfo(fileName).absolutePath());
+    m_file.setFileName(fileName);
+    if (!m_file.exists() && !writeFile(fileName, QByteArray()))
+	return;
+    if (!open())
+	return;
+
+    // start over if the file is not in our format
+    if (m_mapSize < qint64(sizeof(cacheHeader)-1) ||
+	memcmp(m_map, cacheHeader, sizeof(cacheHeader)-1) != 0)
+    {
+	close();
+	if (!writeFile(fileName, QByteArray()) || !open())
+	    return;
+    }
+    buildIndex();
+
+    if (m_mapSize > maxCacheSize) {
+	QByteArray records = recentRecords(maxCacheSize/2);
+	close();
+	if (!writeFile(fileName, records) || !open())
+	    return;
+	buildIndex();
+    }
+}
+
+void DisassCache::buildIndex()
+{
+    const char* data = reinterpret_cast<const char*>(m_map);
+    const char* end = data + m_mapSize;
+    const char* p = data;
+    const char* record = 0;
+    QString key;
+    while (p < end)
+    {
+	const char* eol = static_cast<const char*>(memchr(p, '\n', end-p));
+	if (eol == 0)
+	    break;			/* incomplete line */
+	if (p[0] == '@' && p[1] == '\t') {
+	    record = p;
+	    key = QString::fromUtf8(p+2, eol-p-2);
+	} else if (eol-p == 1 && p[0] == '.' && record != 0) {
+	    // later records override earlier ones
+	    m_index[key] = record - data;
+	    record = 0;
+	}
+	p = eol+1;
+    }
+    TRACE(QString::asprintf("disassembly cache: %d lines in ", m_index.size()) +
+	  m_file.fileName());
+}
+
+/*
+ * Returns the offset after the record at offset; the record is complete.
+ */
+qint64 DisassCache::recordEnd(qint64 offset) const
+{
+    const char* data = reinterpret_cast<const char*>(m_map);
+    const char* p = data + offset;
+    for (;;) {
+	const char* eol = static_cast<const char*>(memchr(p, '\n', data+m_mapSize-p));
+	if (eol-p == 1 && p[0] == '.')
+	    return eol+1 - data;
+	p = eol+1;
+    }
+}
+
+/*
+ * Returns the latest records of the index, at most maxSize bytes, in the
+ * order in which they were written.
+ */
+QByteArray DisassCache::recentRecords(qint64 maxSize) const
+{
+    std::vector<qint64> offsets;
+    offsets.reserve(m_index.size());
+    for (QHash<QString, qint64>::const_iterator i = m_index.begin(); i != m_index.end(); ++i)
+	offsets.push_back(*i);
+    std::sort(offsets.begin(), offsets.end());
+
+    std::vector<qint64>::iterator first = offsets.end();
+    qint64 size = 0;
+    while (first != offsets.begin()) {
+	qint64 len = recordEnd(first[-1]) - first[-1];
+	if (size + len > maxSize)
+	    break;
+	size += len;
+	--first;
+    }
+
+    QByteArray records;
+    records.reserve(size);
+    const char* data = reinterpret_cast<const char*>(m_map);
+    for (std::vector<qint64>::iterator o = first; o != offsets.end(); ++o)
+	records.append(data + *o, recordEnd(*o) - *o);
+    return records;
+}
+
+QString DisassCache::makeKey(const QString& context, const QString& file, int lineNo)
+{
+    return context + '\t' + file + '\t' + QString::number(lineNo);
+}
+
+bool DisassCache::find(const QString& context, const QString& file, int lineNo,
+		       const QString& from, const QString& to,
+		       std::list<DisassembledCode>& code) const
+{
+    if (context.isEmpty())
+	return false;
+
+    QString key = makeKey(context, file, lineNo);
+    QHash<QString, Lines>::const_iterator a = m_added.find(key);
+    if (a != m_added.end()) {
+	if (a->range != Range(from, to))
+	    return false;
+	code = a->code;
+	return true;
+    }
+    QHash<QString, qint64>::const_iterator i = m_index.find(key);
+    if (i == m_index.end())
+	return false;
+
+    // decode the record; skip the key, and check the range
+    const char* p = reinterpret_cast<const char*>(m_map) + *i;
+    p = strchr(p, '\n') + 1;
+    const char* eol = strchr(p, '\n');
+    QByteArray range = "R\t" + from.toLatin1() + '\t' + to.toLatin1();
+    if (eol-p != range.size() || memcmp(p, range.constData(), range.size()) != 0)
+	return false;
+    p = eol+1;
+    code.clear();
+    while (!(p[0] == '.' && p[1] == '\n'))
+    {
+	eol = strchr(p, '\n');
+	const char* tab = static_cast<const char*>(memchr(p, '\t', eol-p));
+	DisassembledCode c;
+	if (tab != 0) {
+	    c.address = QString::fromLatin1(p, tab-p);
+	    c.code = QString::fromUtf8(tab+1, eol-tab-1);
+	}
+	code.push_back(c);
+	p = eol+1;
+    }
+    return true;
+}
+
+void DisassCache::addRange(const QString& context, const QString& file, int lineNo,
+			   const QString& from, const QString& to)
+{
+    if (context.isEmpty())
+	return;
+    m_ranges.insert(makeKey(context, file, lineNo), qMakePair(from, to));
+}
+
+void DisassCache::add(const QString& context, const QString& file, int lineNo,
+		      const std::list<DisassembledCode>& code)
+{
+    if (context.isEmpty() || !m_file.isOpen() || code.empty())
+	return;
+    QString key = makeKey(context, file, lineNo);
+    if (key.contains('\n'))
+	return;
+
+    Range range = m_ranges.take(key);
+    QByteArray rec = "@\t" + key.toUtf8() + "\n"
+		"R\t" + range.first.toLatin1() + '\t' + range.second.toLatin1() + '\n';
+    Lines stored;
+    stored.range = range;
+    for (std::list<DisassembledCode>::const_iterator c = code.begin(); c != code.end(); ++c)
+    {
+	QString text = c->code;
+	while (text.endsWith('\n'))
+	    text.truncate(text.length()-1);
+	/*
+	 * Lines without an address are error messages; they must not be
+	 * recorded since they may not happen next time.
+	 */
+	if (c->address.isEmpty() || text.contains('\n'))
+	    return;
+	rec += c->address.asString().toLatin1() + '\t' + text.toUtf8() + '\n';
+	stored.code.push_back(*c);
+	stored.code.back().code = text;
+    }
+    rec += ".\n";
+
+    // beyond the limit, the records are only kept for this session
+    if (m_file.size() < maxCacheSize) {
+	m_file.write(rec);
+	m_file.flush();
+    }
+    m_added.insert(key, stored);
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright Johannes Sixt
+ * This file is licensed under the GNU General Public License Version 2.
+ * See the file COPYING in the toplevel directory of the source directory.
+ */
+
+#ifndef DISASSCACHE_H
+#define DISASSCACHE_H
+
+#include <QFile>
+#include <QHash>
+#include <QPair>
+#include <QString>
+#include <list>
+
+struct DisassembledCode;
+
+
+/**
+ * Keeps the disassembled code of source lines across sessions.
+ *
+ * The code of a source line is recorded together with the address range
+ * that "info line" reported for it. The records are appended to a file
+ * per executable (see cacheNameForExe()). When the cache is loaded, the
+ * file is mapped into memory, and only an index of the records is built;
+ * a record is decoded when it is asked for.
+ *
+ * The addresses depend on the disassembly flavor and on whether the
+ * program was started (shared objects and position independent
+ * executables are relocated); the caller passes these as the context.
+ * Since a library may be rebuilt or loaded elsewhere, the code is used
+ * only if "info line" still reports the recorded range.
+ *
+ * When the file grows beyond a limit, it is rewritten at the next load
+ * with only the most recent records.
+ */
+class DisassCache
+{
+public:
+    DisassCache();
+    ~DisassCache();
+
+    /**
+     * Opens the cache that belongs to \a executable.
+     */
+    void load(const QString& executable);
+    void close();
+
+    /**
+     * Looks up the code of a line whose address range is \a from to \a to.
+     */
+    bool find(const QString& context, const QString& file, int lineNo,
+	      const QString& from, const QString& to,
+	      std::list<DisassembledCode>& code) const;
+    /**
+     * Remembers the address range of a line. It is recorded when the code
+     * of the line is added.
+     */
+    void addRange(const QString& context, const QString& file, int lineNo,
+		  const QString& from, const QString& to);
+    void add(const QString& context, const QString& file, int lineNo,
+	     const std::list<DisassembledCode>& code);
+
+protected:
+    typedef QPair<QString,QString> Range;
+    struct Lines
+    {
+	Range range;
+	std::list<DisassembledCode> code;
+    };
+    static QString makeKey(const QString& context, const QString& file, int lineNo);
+    bool open();
+    void unmap();
+    void buildIndex();
+    qint64 recordEnd(qint64 offset) const;
+    QByteArray recentRecords(qint64 maxSize) const;
+    static bool writeFile(const QString& fileName, const QByteArray& records);
+    QFile m_file;			/* the records are appended here */
+    const uchar* m_map;			/* the records that existed at load */
+    qint64 m_mapSize;
+    QHash<QString, qint64> m_index;	/* key -> offset of the record in m_map */
+    QHash<QString, Lines> m_added;
+    QHash<QString, Range> m_ranges;
+};
+
+#endif // DISASSCACHE_H
@@ -22,6 +22,7 @@ VarTree::VarTree(VarTree* parent, ExprValue* v) :
 	m_varKind(v->m_varKind),
 	m_nameKind(v->m_nameKind),
 	m_type(0),
+	m_typeFromCache(false),
 	m_exprIndex(0),
 	m_exprIndexUseGuard(false),
 	m_baseValue(v->m_value),
@@ -30,7 +31,7 @@ VarTree::VarTree(VarTree* parent, ExprValue* v) :
 {
     setText(v->m_name);
     updateValueText();
-    if (v->m_child != 0 || m_varKind == VarTree::VKpointer)
+    if (v->m_child != 0 || m_varKind == VarTree::VKpointer || m_varKind == VarTree::VKlazy)
 	setChildIndicatorPolicy(QTreeWidgetItem::ShowIndicator);
     else
 	setChildIndicatorPolicy(QTreeWidgetItem::DontShowIndicator);
@@ -42,6 +43,7 @@ VarTree::VarTree(ExprWnd* parent, ExprValue* v) :
 	m_varKind(VKsimple),
 	m_nameKind(VarTree::NKplain),
 	m_type(0),
+	m_typeFromCache(false),
 	m_exprIndex(0),
 	m_exprIndexUseGuard(false),
 	m_baseValue(v->m_value),
@@ -66,8 +68,9 @@ QString VarTree::computeExpr() const
     VarTree* par = static_cast<VarTree*>(parent());
     QString parentExpr = par->computeExpr();
 
-    // skip this item's name if it is a base class or anonymous struct or union
-    if (m_nameKind == NKtype || m_nameKind == NKanonymous) {
+    // skip this item's name if it is a base class or anonymous struct or union,
+    // or a range of array elements
+    if (m_nameKind == NKtype || m_nameKind == NKanonymous || m_nameKind == NKrange) {
 	return parentExpr;
     }
     /* augment by this item's text */
@@ -103,6 +106,7 @@ QString VarTree::computeExpr() const
     case VKsimple:			/* parent can't be simple */
     case VKpointer:			/* handled in NKaddress */
     case VKdummy:			/* can't occur at all */
+    case VKlazy:			/* has no children */
 	ASSERT(false);
 	result = parentExpr;		/* paranoia */
 	break;
@@ -245,7 +249,7 @@ bool VarTree::isWcharT() const
 /*
  * Get the type of the first base class whose type we know.
  */
-const TypeInfo* VarTree::inferTypeFromBaseClass()
+const TypeInfo* VarTree::inferTypeFromBaseClass(QString* baseName)
 {
     if (m_varKind == VKstruct) {
 	for (int i = 0; i < childCount(); i++)
@@ -258,6 +262,8 @@ const TypeInfo* VarTree::inferTypeFromBaseClass()
 		child->m_type != TypeInfo::unknownType())
 	    {
 		// got a type!
+		if (baseName != 0)
+		    *baseName = child->getText().mid(1, child->getText().length()-2);
 		return child->m_type;
 	    }
 	}
@@ -278,6 +284,8 @@ ExprValue::ExprValue(const QString& name, VarTree::NameKind aKind) :
 	m_nameKind(aKind),
 	m_child(0),
 	m_next(0),
+	m_lastChild(0),
+	m_childCount(0),
 	m_initiallyExpanded(false)
 {
 }
@@ -285,32 +293,60 @@ ExprValue::ExprValue(const QString& name, VarTree::NameKind aKind) :
 ExprValue::~ExprValue()
 {
     delete m_child;
-    delete m_next;
+    // delete the siblings in a loop; arrays can be too long for recursion
+    while (m_next != 0) {
+	ExprValue* n = m_next;
+	m_next = n->m_next;
+	n->m_next = 0;
+	delete n;
+    }
 }
 
-void ExprValue::appendChild(ExprValue* newChild)
+/*
+ * Values are carved from blocks of this many; freed values are kept in a
+ * free list for reuse. The blocks are never released.
+ */
+static const int exprValuesPerBlock = 512;
+static void* exprValueFreeList = 0;
+
+void* ExprValue::operator new(size_t size)
 {
-    if (m_child == 0) {
-	m_child = newChild;
-    } else {
-	// walk chain of children to find the last one
-	ExprValue* last = m_child;
-	while (last->m_next != 0)
-	    last = last->m_next;
-	last->m_next = newChild;
+    if (size != sizeof(ExprValue))
+	return ::operator new(size);
+    if (exprValueFreeList == 0) {
+	char* block = static_cast<char*>(::operator new(exprValuesPerBlock * sizeof(ExprValue)));
+	for (int i = exprValuesPerBlock-1; i >= 0; i--) {
+	    void** p = reinterpret_cast<void**>(block + i * sizeof(ExprValue));
+	    *p = exprValueFreeList;
+	    exprValueFreeList = p;
+	}
     }
-    newChild->m_next = 0;	// just to be sure
+    void* p = exprValueFreeList;
+    exprValueFreeList = *static_cast<void**>(p);
+    return p;
 }
 
-int ExprValue::childCount() const
+void ExprValue::operator delete(void* p, size_t size)
 {
-    int i = 0;
-    ExprValue* c = m_child;
-    while (c) {
-	++i;
-	c = c->m_next;
+    if (p == 0)
+	return;
+    if (size != sizeof(ExprValue)) {
+	::operator delete(p);
+	return;
     }
-    return i;
+    *static_cast<void**>(p) = exprValueFreeList;
+    exprValueFreeList = p;
+}
+
+void ExprValue::appendChild(ExprValue* newChild)
+{
+    if (m_child == 0)
+	m_child = newChild;
+    else
+	m_lastChild->m_next = newChild;
+    m_lastChild = newChild;
+    m_childCount++;
+    newChild->m_next = 0;	// just to be sure
 }
 
 
@@ -361,6 +397,7 @@ VarTree* ExprWnd::insertExpr(ExprValue* expr, ProgramTypeTable& typeTable)
 
 void ExprWnd::updateExpr(ExprValue* expr, ProgramTypeTable& typeTable)
 {
+    TRACE_SPAN("ExprWnd::updateExpr");
     // search the root variable
     VarTree* item = 0;
     for (int i = 0; i < topLevelItemCount(); i++)
@@ -378,12 +415,62 @@ void ExprWnd::updateExpr(ExprValue* expr, ProgramTypeTable& typeTable)
     collectUnknownTypes(item);
 }
 
+/*
+ * Parses an array index "[a]" or a range of indices "[a .. b]".
+ */
+static bool parseIndexRange(const QString& name, int& first, int& last)
+{
+    if (!name.startsWith('[') || !name.endsWith(']'))
+	return false;
+    QString inner = name.mid(1, name.length()-2);
+    int dots = inner.indexOf("..");
+    bool ok1, ok2 = true;
+    if (dots < 0) {
+	first = last = inner.toInt(&ok1);
+    } else {
+	first = inner.left(dots).trimmed().toInt(&ok1);
+	last = inner.mid(dots+2).trimmed().toInt(&ok2);
+    }
+    return ok1 && ok2;
+}
+
 void ExprWnd::updateExpr(VarTree* display, ExprValue* newValues, ProgramTypeTable& typeTable)
 {
+    TRACE_SPAN("ExprWnd::updateExpr");
+
+    /*
+     * The elements of a range are fetched as an array that starts at
+     * index 0; move the indices to where the range starts.
+     */
+    int start, end;
+    if (display->m_nameKind == VarTree::NKrange && rangeBounds(display, start, end))
+    {
+	for (ExprValue* v = newValues->m_child; v != 0; v = v->m_next)
+	{
+	    int first, last;
+	    if (!parseIndexRange(v->m_name, first, last))
+		continue;
+	    if (first == last)
+		v->m_name = QString("[%1]").arg(start + first);
+	    else
+		v->m_name = QString("[%1 .. %2]").arg(start + first).arg(start + last);
+	}
+    }
+
     updateExprRec(display, newValues, typeTable);
     collectUnknownTypes(display);
 }
 
+/*
+ * Tells whether the tail of the array \a display is shown as ranges.
+ */
+static bool hasRanges(VarTree* display)
+{
+    int n = display->childCount();
+    return display->m_varKind == VarTree::VKarray && n > 0 &&
+	display->child(n-1)->m_nameKind == VarTree::NKrange;
+}
+
 /*
  * returns true if there's a visible change
  */
@@ -404,14 +491,90 @@ void ExprWnd::updateExprRec(VarTree* display, ExprValue* newValues, ProgramTypeT
 	return;
     }
 
+    /*
+     * The members of a value that was listed without them are inserted
+     * when they arrive; this happens when the value is expanded.
+     */
+    if (display->m_varKind == VarTree::VKlazy &&
+	(newValues->m_varKind == VarTree::VKstruct ||
+	 newValues->m_varKind == VarTree::VKarray))
+    {
+	display->m_varKind = newValues->m_varKind;
+	updateSingleExpr(display, newValues);
+	replaceChildren(display, newValues);
+	display->inferTypesOfChildren(typeTable);
+	return;
+    }
+
+    /*
+     * If a struct or array is listed again without its members, we keep
+     * those that are shown. If it is collapsed, they are dropped and
+     * fetched again when it is expanded.
+     */
+    if (newValues->m_varKind == VarTree::VKlazy &&
+	(display->m_varKind == VarTree::VKstruct ||
+	 display->m_varKind == VarTree::VKarray))
+    {
+	if (isExpanded) {
+	    m_updateLazy.push_back(display);
+	} else {
+	    deleteChildren(display);
+	    display->m_varKind = VarTree::VKlazy;
+	    display->m_type = 0;
+	    display->updateValue(newValues->m_value);
+	    display->setChildIndicatorPolicy(QTreeWidgetItem::ShowIndicator);
+	}
+	return;
+    }
+
+    /*
+     * The elements of a range are also inserted without collapsing it.
+     * This happens when the range is expanded by the user.
+     */
+    if (display->m_nameKind == VarTree::NKrange &&
+	newValues->m_varKind == VarTree::VKarray &&
+	display->childCount() != newValues->childCount())
+    {
+	replaceChildren(display, newValues);
+	return;
+    }
+
+    /*
+     * If the tail of a long array is shown as ranges, the new value has
+     * "..." in their place. Keep the ranges; they are fetched separately.
+     */
+    if (keepsRanges(display, newValues))
+    {
+	updateSingleExpr(display, newValues);
+	ExprValue* vNew = newValues->m_child;
+	for (int i = 0; i < display->childCount(); i++)
+	{
+	    VarTree* vDisplay = display->child(i);
+	    if (vDisplay->m_nameKind == VarTree::NKrange) {
+		refreshRange(vDisplay);
+		continue;
+	    }
+	    if (vDisplay->getText() != vNew->m_name) {
+		vDisplay->setText(vNew->m_name);
+	    }
+	    updateExprRec(vDisplay, vNew, typeTable);
+	    vNew = vNew->m_next;
+	}
+	return;
+    }
+
     /*
      * If the display and newValues have different kind or if their number
-     * of children is different, replace the whole sub-tree.
+     * of children is different, replace the whole sub-tree. Ranges that
+     * are not kept are also replaced; they are rebuilt when the length of
+     * the array is known.
      */
     if (// the next two lines mean: not(m_varKind remains unchanged)
 	!(newValues->m_varKind == VarTree::VKdummy ||
 	  display->m_varKind == newValues->m_varKind)
 	||
+	(display->m_nameKind != VarTree::NKrange && hasRanges(display))
+	||
 	(display->childCount() != newValues->childCount() &&
 	 /*
 	  * If this is a pointer and newValues doesn't have children, we
@@ -435,7 +598,8 @@ void ExprWnd::updateExprRec(VarTree* display, ExprValue* newValues, ProgramTypeT
 	// update the m_varKind
 	if (newValues->m_varKind != VarTree::VKdummy) {
 	    display->m_varKind = newValues->m_varKind;
-	    if (newValues->m_child != 0 || newValues->m_varKind == VarTree::VKpointer)
+	    if (newValues->m_child != 0 || newValues->m_varKind == VarTree::VKpointer ||
+		newValues->m_varKind == VarTree::VKlazy)
 		display->setChildIndicatorPolicy(QTreeWidgetItem::ShowIndicator);
 	    else
 		display->setChildIndicatorPolicy(QTreeWidgetItem::DontShowIndicator);
@@ -537,11 +701,7 @@ void ExprWnd::replaceChildren(VarTree* display, ExprValue* newValues)
 {
     ASSERT(display->childCount() == 0 || display->m_varKind != VarTree::VKsimple);
 
-    // delete all children of display
-    while (VarTree* c = display->child(0)) {
-	unhookSubtree(c);
-	delete c;
-    }
+    deleteChildren(display);
     // insert copies of the newValues
     for (ExprValue* v = newValues->m_child; v != 0; v = v->m_next)
     {
@@ -549,6 +709,127 @@ void ExprWnd::replaceChildren(VarTree* display, ExprValue* newValues)
 	// recurse
 	replaceChildren(vNew, v);
     }
+
+    // the rest of an array that gdb left out is shown as ranges
+    if (newValues->m_varKind == VarTree::VKarray &&
+	display->m_nameKind != VarTree::NKrange &&
+	newValues->m_lastChild != 0 && newValues->m_lastChild->m_name == "...")
+    {
+	m_updateArrays.push_back(display);
+    }
+}
+
+void ExprWnd::deleteChildren(VarTree* display)
+{
+    /*
+     * The pending commands of the children are found through their
+     * top-level item; therefore, they must be unhooked before they are
+     * detached.
+     */
+    unhookChildren(display);
+
+    // all at once, which is much cheaper than one by one for long arrays
+    QList<QTreeWidgetItem*> children = display->takeChildren();
+    qDeleteAll(children);
+}
+
+/*
+ * Long arrays are shown in ranges of this many elements. If there would
+ * be more than rangesPerLevel ranges, the ranges are made larger; they
+ * are then divided into smaller ranges when they are expanded.
+ */
+static const int elementsPerRange = 100;
+static const int rangesPerLevel = 100;
+
+bool ExprWnd::keepsRanges(VarTree* display, ExprValue* newValues)
+{
+    int n = newValues->childCount();
+    if (!(display->m_varKind == VarTree::VKarray &&
+	  newValues->m_varKind == VarTree::VKarray &&
+	  n > 0 && newValues->m_lastChild->m_name == "..." &&
+	  display->childCount() >= n &&
+	  display->child(n-1)->m_nameKind == VarTree::NKrange &&
+	  (n == 1 || display->child(n-2)->m_nameKind != VarTree::NKrange)))
+	return false;
+
+    // the ranges must begin after the last element that gdb has shown
+    int first = 0, last = -1;
+    if (n >= 2) {
+	ExprValue* v = newValues->m_child;
+	for (int i = 0; i < n-2; i++)
+	    v = v->m_next;
+	if (!parseIndexRange(v->m_name, first, last))
+	    return false;
+    }
+    int start, end;
+    return rangeBounds(display->child(n-1), start, end) && start == last+1;
+}
+
+void ExprWnd::addRanges(VarTree* parent, int first, int end)
+{
+    int size = elementsPerRange;
+    while ((end - first + size - 1) / size > rangesPerLevel)
+	size *= rangesPerLevel;
+
+    for (int i = first; i < end; i += size)
+    {
+	int last = qMin(end - i, size) + i - 1;
+	ExprValue v(QString("[%1..%2]").arg(i).arg(last), VarTree::NKrange);
+	v.m_varKind = VarTree::VKarray;
+	VarTree* range = new VarTree(parent, &v);
+	range->setChildIndicatorPolicy(QTreeWidgetItem::ShowIndicator);
+    }
+}
+
+void ExprWnd::insertRanges(VarTree* array, int length)
+{
+    int n = array->childCount();
+    if (n == 0 || array->child(n-1)->getText() != "...")
+	return;
+
+    // find the index after the last element that gdb has shown
+    int first = 0, last = -1;
+    if (n >= 2 && !parseIndexRange(array->child(n-2)->getText(), first, last))
+	return;
+    if (length <= last+1)
+	return;
+
+    VarTree* dots = array->child(n-1);
+    unhookSubtree(dots);
+    delete dots;
+    addRanges(array, last+1, length);
+}
+
+bool ExprWnd::expandRange(VarTree* range)
+{
+    int first, last;
+    if (range->childCount() > 0 || !rangeBounds(range, first, last))
+	return false;
+    if (last - first + 1 > elementsPerRange) {
+	addRanges(range, first, last+1);
+	return false;
+    }
+    return true;
+}
+
+bool ExprWnd::rangeBounds(const VarTree* range, int& first, int& last)
+{
+    return parseIndexRange(range->getText(), first, last);
+}
+
+void ExprWnd::refreshRange(VarTree* range)
+{
+    if (!range->isExpanded()) {
+	// the elements are fetched again when the range is expanded
+	deleteChildren(range);
+	return;
+    }
+    if (range->childCount() > 0 && range->child(0)->m_nameKind == VarTree::NKrange) {
+	for (int i = 0; i < range->childCount(); i++)
+	    refreshRange(range->child(i));
+    } else {
+	m_updateRanges.push_back(range);
+    }
 }
 
 void ExprWnd::collectUnknownTypes(VarTree* var)
@@ -650,26 +931,29 @@ void ExprWnd::removeExpr(VarTree* item)
 void ExprWnd::unhookSubtree(VarTree* subTree)
 {
     // must remove any pointers scheduled for update from the list
-    unhookSubtree(m_updatePtrs, subTree);
-    unhookSubtree(m_updateType, subTree);
-    unhookSubtree(m_updateStruct, subTree);
+    m_updatePtrs.unhookSubtree(subTree);
+    m_updateType.unhookSubtree(subTree);
+    m_updateStruct.unhookSubtree(subTree);
+    m_updateLazy.unhookSubtree(subTree);
+    m_updateRanges.unhookSubtree(subTree);
+    m_updateArrays.unhookSubtree(subTree);
     emit removingItem(subTree);
 }
 
-void ExprWnd::unhookSubtree(std::list<VarTree*>& list, VarTree* subTree)
+/*
+ * Each queue is searched only once for all children; this matters when
+ * the elements of a long array are replaced.
+ */
+void ExprWnd::unhookChildren(VarTree* parent)
 {
-    if (subTree == 0)
-	return;
-
-    std::list<VarTree*>::iterator i = list.begin();
-    while (i != list.end()) {
-	std::list<VarTree*>::iterator checkItem = i;
-	++i;
-	if (subTree->isAncestorEq(*checkItem)) {
-	    // checkItem is an item from subTree
-	    list.erase(checkItem);
-	}
-    }
+    m_updatePtrs.unhookChildren(parent);
+    m_updateType.unhookChildren(parent);
+    m_updateStruct.unhookChildren(parent);
+    m_updateLazy.unhookChildren(parent);
+    m_updateRanges.unhookChildren(parent);
+    m_updateArrays.unhookChildren(parent);
+    for (int i = 0; i < parent->childCount(); i++)
+	emit removingItem(parent->child(i));
 }
 
 void ExprWnd::clearPendingUpdates()
@@ -677,36 +961,153 @@ void ExprWnd::clearPendingUpdates()
     m_updatePtrs.clear();
     m_updateType.clear();
     m_updateStruct.clear();
+    m_updateLazy.clear();
+    m_updateRanges.clear();
+    m_updateArrays.clear();
 }
 
 VarTree* ExprWnd::nextUpdatePtr()
 {
-    VarTree* ptr = 0;
-    if (!m_updatePtrs.empty()) {
-	ptr = m_updatePtrs.front();
-	m_updatePtrs.pop_front();
-    }
-    return ptr;
+    return m_updatePtrs.takeNext(this);
 }
 
 VarTree* ExprWnd::nextUpdateType()
 {
-    VarTree* ptr = 0;
-    if (!m_updateType.empty()) {
-	ptr = m_updateType.front();
-	m_updateType.pop_front();
-    }
-    return ptr;
+    return m_updateType.takeNext(this);
 }
 
 VarTree* ExprWnd::nextUpdateStruct()
 {
-    VarTree* ptr = 0;
-    if (!m_updateStruct.empty()) {
-	ptr = m_updateStruct.front();
-	m_updateStruct.pop_front();
+    return m_updateStruct.takeNext(this);
+}
+
+VarTree* ExprWnd::nextUpdateLazy()
+{
+    return m_updateLazy.takeNext(this);
+}
+
+VarTree* ExprWnd::nextUpdateRange()
+{
+    return m_updateRanges.takeNext(this);
+}
+
+VarTree* ExprWnd::nextUpdateArray()
+{
+    return m_updateArrays.takeNext(this);
+}
+
+bool ExprWnd::resumeDeferred(VarTree* item)
+{
+    bool ptr = m_updatePtrs.resumeDeferred(item);
+    bool type = m_updateType.resumeDeferred(item);
+    bool str = m_updateStruct.resumeDeferred(item);
+    bool lazy = m_updateLazy.resumeDeferred(item);
+    bool range = m_updateRanges.resumeDeferred(item);
+    bool array = m_updateArrays.resumeDeferred(item);
+    return ptr || type || str || lazy || range || array;
+}
+
+bool ExprWnd::isShown(const VarTree* item)
+{
+    for (const QTreeWidgetItem* p = item->parent(); p != 0; p = p->parent()) {
+	if (!p->isExpanded())
+	    return false;
+    }
+    return true;
+}
+
+
+void UpdateQueue::push_back(VarTree* var)
+{
+    // an item is registered only once
+    if (m_pos.contains(var))
+	return;
+    m_list.push_back(var);
+    m_pos.insert(var, --m_list.end());
+}
+
+void UpdateQueue::remove(VarTree* var)
+{
+    QHash<VarTree*, std::list<VarTree*>::iterator>::iterator i = m_pos.find(var);
+    if (i != m_pos.end()) {
+	m_list.erase(*i);
+	m_pos.erase(i);
+    }
+}
+
+void UpdateQueue::clear()
+{
+    m_list.clear();
+    m_pos.clear();
+    m_deferred.clear();
+}
+
+void UpdateQueue::unhook(VarTree* subTree, bool withRoot)
+{
+    if (subTree == 0)
+	return;
+
+    std::list<VarTree*>::iterator i = m_list.begin();
+    while (i != m_list.end()) {
+	VarTree* checkItem = *i;
+	++i;
+	if ((withRoot || checkItem != subTree) && subTree->isAncestorEq(checkItem)) {
+	    // checkItem is an item from subTree
+	    remove(checkItem);
+	}
+    }
+    i = m_deferred.begin();
+    while (i != m_deferred.end()) {
+	if ((withRoot || *i != subTree) && subTree->isAncestorEq(*i))
+	    i = m_deferred.erase(i);
+	else
+	    ++i;
+    }
+}
+
+VarTree* UpdateQueue::takeNext(const ExprWnd* wnd)
+{
+    if (m_list.empty())
+	return 0;
+
+    // first the items in the visible rows
+    QRect area = wnd->viewport()->rect();
+    for (QTreeWidgetItem* item = wnd->itemAt(area.topLeft());
+	 item != 0 && wnd->visualItemRect(item).top() <= area.bottom();
+	 item = wnd->itemBelow(item))
+    {
+	VarTree* var = static_cast<VarTree*>(item);
+	if (m_pos.contains(var)) {
+	    remove(var);
+	    return var;
+	}
+    }
+
+    // then the others, except those that cannot be seen without expanding
+    while (!m_list.empty()) {
+	VarTree* var = m_list.front();
+	remove(var);
+	if (ExprWnd::isShown(var))
+	    return var;
+	m_deferred.push_back(var);
+    }
+    return 0;
+}
+
+bool UpdateQueue::resumeDeferred(VarTree* item)
+{
+    bool any = false;
+    std::list<VarTree*>::iterator i = m_deferred.begin();
+    while (i != m_deferred.end()) {
+	if (item->isAncestorEq(*i) && ExprWnd::isShown(*i)) {
+	    push_back(*i);
+	    i = m_deferred.erase(i);
+	    any = true;
+	} else {
+	    ++i;
+	}
     }
-    return ptr;
+    return any;
 }
 
 
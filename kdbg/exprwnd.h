@@ -10,6 +10,7 @@
 #include <QTreeWidget>
 #include <QLineEdit>
 #include <QPixmap>
+#include <QHash>
 #include <list>
 
 class ProgramTypeTable;
@@ -23,15 +24,18 @@ class VarTree : public QTreeWidgetItem
 {
 public:
     enum VarKind { VKsimple, VKpointer, VKstruct, VKarray,
-	VKdummy				//!< used to update only children
+	VKdummy,			//!< used to update only children
+	VKlazy				//!< members are fetched when expanded
     };
     VarKind m_varKind;
     enum NameKind { NKplain, NKstatic, NKtype,
 	NKanonymous,			//!< an anonymous struct or union
-	NKaddress			//!< a dereferenced pointer
+	NKaddress,			//!< a dereferenced pointer
+	NKrange				//!< elements of a long array, fetched on demand
     };
     NameKind m_nameKind;
     const TypeInfo* m_type;			//!< the type of struct if it could be derived
+    bool m_typeFromCache;		//!< m_type was not confirmed by the debugger
     int m_exprIndex;			//!< used in struct value update
     bool m_exprIndexUseGuard;		//!< ditto; if guard expr should be used
     QString m_partialValue;		//!< while struct value update is in progress
@@ -50,8 +54,8 @@ public:
     bool updateStructValue(const QString& newValue);
     /** find out the type of this value using the child values */
     void inferTypesOfChildren(ProgramTypeTable& typeTable);
-    /** get the type from base class part */
-    const TypeInfo* inferTypeFromBaseClass();
+    /** get the type from base class part; also its name if baseName != 0 */
+    const TypeInfo* inferTypeFromBaseClass(QString* baseName = 0);
     /** returns whether the pointer is a wchar_t */
     bool isWcharT() const;
 
@@ -84,17 +88,26 @@ struct ExprValue
     VarTree::NameKind m_nameKind;
     ExprValue* m_child;			/* the first child expression */
     ExprValue* m_next;			/* the next sibling expression */
+    ExprValue* m_lastChild;		/* so that appending is cheap */
+    int m_childCount;
     bool m_initiallyExpanded;
 
     ExprValue(const QString& name, VarTree::NameKind kind);
     ~ExprValue();
 
+    /*
+     * The parsers create and destroy large numbers of values; they are
+     * taken from a pool.
+     */
+    static void* operator new(size_t size);
+    static void operator delete(void* p, size_t size);
+
     const QString& value() const {
         return m_value;
     }
 
     void appendChild(ExprValue* newChild);
-    int childCount() const;
+    int childCount() const { return m_childCount; }
 };
 
 
@@ -119,6 +132,33 @@ signals:
 };
 
 
+/**
+ * Variables that wait for an update. The ones that the user can see are
+ * taken first; the ones in collapsed subtrees are deferred until they are
+ * expanded.
+ */
+class UpdateQueue
+{
+public:
+    void push_back(VarTree* var);
+    void clear();
+    /** removes the items in \a subTree, including the deferred ones */
+    void unhookSubtree(VarTree* subTree) { unhook(subTree, true); }
+    /** removes the items below \a parent, but not \a parent itself */
+    void unhookChildren(VarTree* parent) { unhook(parent, false); }
+    /** returns the next item to update (or 0) and removes it */
+    VarTree* takeNext(const ExprWnd* wnd);
+    /** makes the deferred items below \a item pending again */
+    bool resumeDeferred(VarTree* item);
+
+protected:
+    std::list<VarTree*> m_list;
+    QHash<VarTree*, std::list<VarTree*>::iterator> m_pos;
+    std::list<VarTree*> m_deferred;	//!< items in collapsed subtrees
+    void remove(VarTree* var);
+    void unhook(VarTree* subTree, bool withRoot);
+};
+
 class ExprWnd : public QTreeWidget
 {
     Q_OBJECT
@@ -152,6 +192,22 @@ public:
     VarTree* nextUpdatePtr();
     VarTree* nextUpdateType();
     VarTree* nextUpdateStruct();
+    VarTree* nextUpdateLazy();
+    VarTree* nextUpdateRange();
+    VarTree* nextUpdateArray();
+    /** shows the elements of \a array that gdb left out as ranges, given
+     * the \a length of the array */
+    void insertRanges(VarTree* array, int length);
+    /** fills a range that is expanded; returns true if its elements must
+     * be fetched */
+    bool expandRange(VarTree* range);
+    /** returns the first and last index of a range */
+    static bool rangeBounds(const VarTree* range, int& first, int& last);
+    /** schedules updates that were skipped while \a item was collapsed;
+     * returns true if there are any */
+    bool resumeDeferred(VarTree* item);
+    /** tells whether the item is not inside a collapsed subtree */
+    static bool isShown(const VarTree* item);
     void editValue(VarTree* item, const QString& text);
     /** tells whether the a value is currently edited */
     bool isEditing() const;
@@ -162,20 +218,27 @@ public:
 protected:
     void updateExprRec(VarTree* display, ExprValue* newValues, ProgramTypeTable& typeTable);
     void replaceChildren(VarTree* display, ExprValue* newValues);
+    void deleteChildren(VarTree* display);
+    bool keepsRanges(VarTree* display, ExprValue* newValues);
+    void addRanges(VarTree* parent, int first, int end);
+    void refreshRange(VarTree* range);
     void collectUnknownTypes(VarTree* item);
     void checkUnknownType(VarTree* item);
     static QString formatWCharPointer(QString value);
     QPixmap m_pixPointer;
 
-    std::list<VarTree*> m_updatePtrs;	//!< dereferenced pointers that need update
-    std::list<VarTree*> m_updateType;	//!< structs whose type must be determined
-    std::list<VarTree*> m_updateStruct;	//!< structs whose nested value needs update
+    UpdateQueue m_updatePtrs;		//!< dereferenced pointers that need update
+    UpdateQueue m_updateType;		//!< structs whose type must be determined
+    UpdateQueue m_updateStruct;		//!< structs whose nested value needs update
+    UpdateQueue m_updateLazy;		//!< expanded values whose members are fetched separately
+    UpdateQueue m_updateRanges;		//!< expanded ranges of arrays that need update
+    UpdateQueue m_updateArrays;		//!< truncated arrays whose length is needed
 
     ValueEdit* m_edit;
 
     /** remove items that are in the subTree from the list */
     void unhookSubtree(VarTree* subTree);
-    static void unhookSubtree(std::list<VarTree*>& list, VarTree* subTree);
+    void unhookChildren(VarTree* parent);
 
 signals:
     void removingItem(VarTree*);
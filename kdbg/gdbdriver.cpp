@@ -8,6 +8,7 @@
 #include "exprwnd.h"
 #include <QFileInfo>
 #include <QRegExp>
+#include <QSet>
 #include <QStringList>
 #include <klocalizedstring.h>		/* i18n */
 #include <ctype.h>
@@ -16,6 +17,7 @@
 #include <string.h>			/* strcpy */
 
 #include "assert.h"
+#include "scanner.h"
 #include "mydebug.h"
 
 static void skipString(const char*& p);
@@ -30,9 +32,6 @@ static bool parseValueSeq(const char*& s, ExprValue* variable);
 #define PROMPT "(kdbg)"
 #define PROMPT_LEN 6
 
-// TODO: make this cmd info stuff non-static to allow multiple
-// simultaneous gdbs to run!
-
 struct GdbCmdInfo {
     DbgCommand cmd;
     const char* fmt;			/* format string */
@@ -62,8 +61,11 @@ static const char printQStringStructFmt[] = "print (0?\"%s\":$kdbgundef)\n";
 /*
  * The following array of commands must be sorted by the DC* values,
  * because they are used as indices.
+ *
+ * The table is shared by all drivers; formats that depend on the gdb at
+ * hand or on the program are kept per driver, see GdbDriver::cmdFmt().
  */
-static GdbCmdInfo cmds[] = {
+static const GdbCmdInfo cmds[] = {
     { DCinitialize, "", GdbCmdInfo::argNone },
     { DCtty, "tty %s\n", GdbCmdInfo::argString },
     { DCexecutable, "file \"%s\"\n", GdbCmdInfo::argString },
@@ -87,7 +89,7 @@ static GdbCmdInfo cmds[] = {
     { DCunsetenv, "unset env %s\n", GdbCmdInfo::argString },
     { DCsetoption, "setoption %s %d\n", GdbCmdInfo::argStringNum},
     { DCcd, "cd %s\n", GdbCmdInfo::argString },
-    { DCbt, "bt\n", GdbCmdInfo::argNone },
+    { DCbt, "bt %d\n", GdbCmdInfo::argNum },
     { DCrun, "run\n", GdbCmdInfo::argNone },
     { DCcont, "cont\n", GdbCmdInfo::argNone },
     { DCstep, "step\n", GdbCmdInfo::argNone },
@@ -123,13 +125,17 @@ static GdbCmdInfo cmds[] = {
     { DCignore, "ignore %d %d\n", GdbCmdInfo::argNum2},
     { DCprintWChar, "print ($s=%s)?*$s@wcslen($s):0x0\n", GdbCmdInfo::argString },
     { DCsetvariable, "set variable %s=%s\n", GdbCmdInfo::argString2 },
+    { DCprintBatch, "print %s\n", GdbCmdInfo::argString },
 };
 
 #define NUM_CMDS (int(sizeof(cmds)/sizeof(cmds[0])))
 #define MAX_FMTLEN 200
 
 GdbDriver::GdbDriver() :
-	DebuggerDriver()
+	DebuggerDriver(),
+	m_printQStringFmt(printQStringStructFmt),
+	m_disassFmt(cmds[DCdisassemble].fmt),
+	m_haveWithMaxDepth(false)
 {
 #ifndef NDEBUG
     // check command info array
@@ -265,6 +271,15 @@ bool GdbDriver::startup(QString cmdStr)
 	"info locals\n"			/* local vars supersede args with same name */
 	"info args\n"			/* therefore, arguments must come last */
 	"end\n"
+	/*
+	 * The same without the members of structs and arrays (gdb 10 and
+	 * later). "with" restores max-depth even if the command is
+	 * interrupted or fails.
+	 */
+	"define kdbg__shallowlocals\n"
+	"with print max-depth 0 -- info locals\n"
+	"with print max-depth 0 -- info args\n"
+	"end\n"
 	/*
 	 * Work around a bug in gdb-6.3: "info line main" crashes gdb.
 	 */
@@ -281,7 +296,7 @@ bool GdbDriver::startup(QString cmdStr)
     executeCmdString(DCinitialize, gdbInitialize, false);
 
     // assume that QString::null is ok
-    cmds[DCprintQStringStruct].fmt = printQStringStructFmt;
+    m_printQStringFmt = printQStringStructFmt;
 
     return true;
 }
@@ -321,8 +336,9 @@ void GdbDriver::commandFinished(CmdQueueItem* cmd)
 		{
 		    disass = "disassemble %s, %s\n";
 		}
+		m_haveWithMaxDepth = major >= 10;
 	    }
-	    cmds[DCdisassemble].fmt = disass;
+	    m_disassFmt = disass;
 
 	    m_littleendian = m_output.contains("little endian");
 	}
@@ -352,7 +368,7 @@ void GdbDriver::commandFinished(CmdQueueItem* cmd)
     }
 }
 
-int GdbDriver::findPrompt(const QByteArray& output) const
+int GdbDriver::findPrompt(const QByteArray& output, int&) const
 {
     /*
      * If there's a prompt string in the collected output, it must be at
@@ -374,6 +390,84 @@ int GdbDriver::findPrompt(const QByteArray& output) const
     return -1;
 }
 
+/*
+ * A pipelined command is followed by an echo command that prints a marker
+ * with the command's tag. Since gdb executes the commands in order, the
+ * marker ends the output of the command.
+ */
+static QByteArray pipeMarker(uint tag)
+{
+    return "\032kdbg" + QByteArray::number(tag) + '\n';
+}
+
+QByteArray GdbDriver::commandBytes(CmdQueueItem* cmd)
+{
+    /*
+     * The print commands of a batch are separated by prompts; the batch
+     * must be ended by a marker.
+     */
+    if (cmd->m_cmd == DCprintBatch && cmd->m_pipeTag == 0)
+	cmd->m_pipeTag = ++m_tagCounter;
+
+    QByteArray str = DebuggerDriver::commandBytes(cmd);
+    if (cmd->m_pipeTag != 0) {
+	str += "echo \\032kdbg" + QByteArray::number(cmd->m_pipeTag) + "\\n\n";
+    }
+    return str;
+}
+
+bool GdbDriver::canPipeline(const CmdQueueItem* cmd) const
+{
+    // only commands that neither run the program nor change its state
+    switch (cmd->m_cmd) {
+    case DCinfolocals:
+    case DCinforegisters:
+    case DCexamine:
+    case DCbt:
+    case DCinfothreads:
+    case DCinfobreak:
+    case DCinfoline:
+    case DCdisassemble:
+    case DCprint:
+    case DCprintDeref:
+    case DCprintStruct:
+    case DCprintQStringStruct:
+    case DCprintWChar:
+    case DCprintBatch:
+    case DCfindType:
+	return true;
+    default:
+	return false;
+    }
+}
+
+int GdbDriver::findPipeMarker(const QByteArray& output, uint tag,
+			      int& consumed, int& scanned) const
+{
+    QByteArray marker = pipeMarker(tag);
+    int pos = output.indexOf(marker, scanned);
+    if (pos < 0) {
+	// the marker may have arrived only partially
+	scanned = qMax(0, output.length() - marker.length() + 1);
+	return -1;
+    }
+    scanned = pos;
+
+    // the echo command is followed by a prompt, too
+    int end = pos + marker.length();
+    if (output.length() < end + PROMPT_LEN)
+	return -1;
+    consumed = end + PROMPT_LEN;
+
+    // remove the prompt that ends the output of the command
+    if (pos >= PROMPT_LEN &&
+	strncmp(output.data()+pos-PROMPT_LEN, PROMPT, PROMPT_LEN) == 0)
+    {
+	pos -= PROMPT_LEN;
+    }
+    return pos;
+}
+
 /*
  * The --fullname option makes gdb send a special normalized sequence print
  * each time the program stops and at some other points. The sequence has
@@ -432,6 +526,21 @@ static void normalizeStringArg(QString& arg)
     }
 }
 
+const char* GdbDriver::cmdFmt(DbgCommand cmd) const
+{
+    switch (cmd) {
+    case DCprintQStringStruct:
+	return m_printQStringFmt.constData();
+    case DCdisassemble:
+	return m_disassFmt;
+    case DCinfolocals:
+	if (m_shallowLocals && m_haveWithMaxDepth)
+	    return "kdbg__shallowlocals\n";
+	return cmds[cmd].fmt;
+    default:
+	return cmds[cmd].fmt;
+    }
+}
 
 QString GdbDriver::makeCmdString(DbgCommand cmd, QString strArg)
 {
@@ -440,6 +549,16 @@ QString GdbDriver::makeCmdString(DbgCommand cmd, QString strArg)
 
     normalizeStringArg(strArg);
 
+    if (cmd == DCprintBatch) {
+	// one print command per expression
+	QString cmdString;
+	foreach (QString expr, strArg.split('\n', QString::SkipEmptyParts)) {
+	    normalizeStringArg(expr);
+	    cmdString += QString::asprintf(cmdFmt(cmd), expr.toUtf8().constData());
+	}
+	return cmdString;
+    }
+
     if (cmd == DCcd) {
 	// need the working directory when parsing the output
 	m_programWD = strArg;
@@ -451,7 +570,7 @@ QString GdbDriver::makeCmdString(DbgCommand cmd, QString strArg)
 	strArg = m_redirect + " " + strArg;
     }
 
-    return QString::asprintf(cmds[cmd].fmt, strArg.toUtf8().constData());
+    return QString::asprintf(cmdFmt(cmd), strArg.toUtf8().constData());
 }
 
 QString GdbDriver::makeCmdString(DbgCommand cmd, int intArg)
@@ -459,7 +578,7 @@ QString GdbDriver::makeCmdString(DbgCommand cmd, int intArg)
     assert(cmd >= 0 && cmd < NUM_CMDS);
     assert(cmds[cmd].argsNeeded == GdbCmdInfo::argNum);
 
-    return QString::asprintf(cmds[cmd].fmt, intArg);
+    return QString::asprintf(cmdFmt(cmd), intArg);
 }
 
 QString GdbDriver::makeCmdString(DbgCommand cmd, QString strArg, int intArg1, int intArg2)
@@ -546,11 +665,11 @@ QString GdbDriver::makeCmdString(DbgCommand cmd, QString strArg, int intArg)
 	    // must split off file name part
 	    strArg = QFileInfo(strArg).fileName();
 	}
-	cmdString = QString::asprintf(cmds[cmd].fmt, strArg.toUtf8().constData(), intArg);
+	cmdString = QString::asprintf(cmdFmt(cmd), strArg.toUtf8().constData(), intArg);
     }
     else
     {
-	cmdString = QString::asprintf(cmds[cmd].fmt, intArg, strArg.toUtf8().constData());
+	cmdString = QString::asprintf(cmdFmt(cmd), intArg, strArg.toUtf8().constData());
     }
     return cmdString;
 }
@@ -563,7 +682,7 @@ QString GdbDriver::makeCmdString(DbgCommand cmd, QString strArg1, QString strArg
     normalizeStringArg(strArg1);
     normalizeStringArg(strArg2);
 
-    return QString::asprintf(cmds[cmd].fmt,
+    return QString::asprintf(cmdFmt(cmd),
 		      strArg1.toUtf8().constData(),
 		      strArg2.toUtf8().constData());
 }
@@ -573,7 +692,7 @@ QString GdbDriver::makeCmdString(DbgCommand cmd, int intArg1, int intArg2)
     assert(cmd >= 0 && cmd < NUM_CMDS);
     assert(cmds[cmd].argsNeeded == GdbCmdInfo::argNum2);
 
-    return QString::asprintf(cmds[cmd].fmt, intArg1, intArg2);
+    return QString::asprintf(cmdFmt(cmd), intArg1, intArg2);
 }
 
 QString GdbDriver::makeCmdString(DbgCommand cmd)
@@ -581,7 +700,7 @@ QString GdbDriver::makeCmdString(DbgCommand cmd)
     assert(cmd >= 0 && cmd < NUM_CMDS);
     assert(cmds[cmd].argsNeeded == GdbCmdInfo::argNone);
 
-    return cmds[cmd].fmt;
+    return cmdFmt(cmd);
 }
 
 void GdbDriver::terminate()
@@ -689,7 +808,7 @@ void GdbDriver::setPrintQStringDataCmd(const char* cmd)
     if (cmd == 0 || *cmd == '\0')
 	return;
     assert(strlen(cmd) <= MAX_FMTLEN);
-    cmds[DCprintQStringStruct].fmt = cmd;
+    m_printQStringFmt = cmd;
 }
 
 ExprValue* GdbDriver::parseQCharArray(const char* output, bool wantErrorValue, bool qt3like)
@@ -907,10 +1026,13 @@ static void skipNested(const char*& s, char opening, char closing)
      * Search for next matching `closing' char, skipping nested pairs of
      * `opening' and `closing'.
      */
-    while (*p && nest > 0) {
+    while (nest > 0) {
+	p = scanFor(p, opening, closing);
+	if (*p == '\0')
+	    break;
 	if (*p == opening) {
 	    nest++;
-	} else if (*p == closing) {
+	} else {
 	    nest--;
 	}
 	p++;
@@ -934,8 +1056,11 @@ static void skipNestedAngles(const char*& s)
 
     int nest = 1;
     p++;		// skip the initial '<'
-    while (*p && nest > 0)
+    while (nest > 0)
     {
+	p = scanFor(p, '<', '>');
+	if (*p == '\0')
+	    break;
 	// Below we can check for p-s >= 9 instead of 8 because
 	// *s is '<' and cannot be part of "operator".
 	if (*p == '<')
@@ -970,13 +1095,12 @@ static void skipNestedAngles(const char*& s)
 static void findEnd(const char*& s)
 {
     const char* p = s;
-    while (*p && *p!='\n') {
-	while (*p && *p!='\n' && *p!='{')
-	    p++;
-	if (*p=='{') {
-	    p++;
-	    skipNested(p, '{', '}'); p--;
-	}
+    for (;;) {
+	p = scanFor(p, '\n', '{');
+	if (*p != '{')
+	    break;
+	p++;
+	skipNested(p, '{', '}'); p--;
     }
     s = p;
 }
@@ -1000,13 +1124,16 @@ static void skipString(const char*& p)
 moreStrings:
     // opening quote
     char quote = *p++;
-    while (*p != quote) {
-	if (*p == '\\') {
-	    // skip escaped character
-	    // no special treatment for octal values necessary
-	    p++;
-	}
+    for (;;) {
+	p = scanFor(p, quote, '\\');
+	if (*p == quote)
+	    break;
 	// simply return if no more characters
+	if (*p == '\0')
+	    return;
+	// skip escaped character
+	// no special treatment for octal values necessary
+	p++;
 	if (*p == '\0')
 	    return;
 	p++;
@@ -1087,12 +1214,15 @@ static void skipNestedWithString(const char*& s, char opening, char closing)
      * Search for next matching `closing' char, skipping nested pairs of
      * `opening' and `closing' as well as strings.
      */
-    while (*p && nest > 0) {
+    while (nest > 0) {
+	p = scanFor(p, opening, closing, '\'', '\"');
+	if (*p == '\0')
+	    break;
 	if (*p == opening) {
 	    nest++;
 	} else if (*p == closing) {
 	    nest--;
-	} else if (*p == '\'' || *p == '\"') {
+	} else {
 	    skipString(p);
 	    continue;
 	}
@@ -1218,6 +1348,13 @@ repeat:
 	    skipSpace(s);
 	    goto repeat;
 	}
+	else if (strncmp(s, "{...}", 5) == 0)
+	{
+	    // the members were left out due to "print max-depth"
+	    s += 5;
+	    variable->m_varKind = VarTree::VKlazy;
+	    skipSpace(s);
+	}
 	else
 	{
 	    s++;
@@ -1543,7 +1680,7 @@ static bool parseValueSeq(const char*& s, ExprValue* variable)
     int index = 0;
     bool good;
     for (;;) {
-	QString name = QString::asprintf("[%d]", index);
+	QString name = QLatin1Char('[') + QString::number(index) + QLatin1Char(']');
 	ExprValue* var = new ExprValue(name, VarTree::NKplain);
 	good = parseValue(s, var);
 	if (!good) {
@@ -2166,6 +2303,7 @@ void GdbDriver::parseLocals(const char* output, std::list<ExprValue*>& newVars)
 	return;
     }
 
+    QSet<QString> names;		/* to find duplicates quickly */
     while (*output != '\0') {
 	skipSpace(output);
 	if (*output == '\0')
@@ -2186,14 +2324,12 @@ void GdbDriver::parseLocals(const char* output, std::list<ExprValue*>& newVars)
 	    break;
 	}
 	// do not add duplicates
-	for (std::list<ExprValue*>::iterator o = newVars.begin(); o != newVars.end(); ++o) {
-	    if ((*o)->m_name == variable->m_name) {
-		delete variable;
-		goto skipDuplicate;
-	    }
+	if (names.contains(variable->m_name)) {
+	    delete variable;
+	    continue;
 	}
+	names.insert(variable->m_name);
 	newVars.push_back(variable);
-    skipDuplicate:;
     }
 }
 
@@ -2209,6 +2345,27 @@ ExprValue* GdbDriver::parsePrintExpr(const char* output, bool wantErrorValue)
     return var;
 }
 
+bool GdbDriver::canPrintBatch() const
+{
+    return true;
+}
+
+void GdbDriver::parsePrintBatch(const char* output, std::list<ExprValue*>& values)
+{
+    // the outputs of the print commands are separated by prompts
+    const char* p = output;
+    for (;;) {
+	const char* end = strstr(p, "\n" PROMPT);
+	if (end == 0) {
+	    values.push_back(parsePrintExpr(p, true));
+	    break;
+	}
+	QByteArray one(p, end+1-p);
+	values.push_back(parsePrintExpr(one.constData(), true));
+	p = end+1+PROMPT_LEN;
+    }
+}
+
 bool GdbDriver::parseChangeWD(const char* output, QString& message)
 {
     bool isGood = false;
@@ -39,6 +39,8 @@ public:
 				 QString& file, int& lineNo, QString& address) override;
     void parseLocals(const char* output, std::list<ExprValue*>& newVars) override;
     ExprValue* parsePrintExpr(const char* output, bool wantErrorValue) override;
+    bool canPrintBatch() const override;
+    void parsePrintBatch(const char* output, std::list<ExprValue*>& values) override;
     bool parseChangeWD(const char* output, QString& message) override;
     bool parseChangeExecutable(const char* output, QString& message) override;
     bool parseCoreFile(const char* output) override;
@@ -60,6 +62,14 @@ protected:
     QString m_redirect;			/* redirection to /dev/null */
     bool m_littleendian = true;		/* if gdb works with little endian or big endian */
     QString m_defaultCmd;		/* how to invoke gdb */
+    QByteArray m_printQStringFmt;	/* set by setPrintQStringDataCmd() */
+    const char* m_disassFmt;		/* depends on the gdb version */
+    bool m_haveWithMaxDepth;		/* gdb knows "with print max-depth" */
+
+    /**
+     * Returns the format string of \a cmd for this driver.
+     */
+    const char* cmdFmt(DbgCommand cmd) const;
 
     QString makeCmdString(DbgCommand cmd) override;
     QString makeCmdString(DbgCommand cmd, QString strArg) override;
@@ -68,7 +78,11 @@ protected:
     QString makeCmdString(DbgCommand cmd, QString strArg1, QString strArg2) override;
     QString makeCmdString(DbgCommand cmd, int intArg1, int intArg2) override;
     QString makeCmdString(DbgCommand cmd, QString strArg, int intArg1, int intArg2) override;
-    int findPrompt(const QByteArray& output) const override;
+    int findPrompt(const QByteArray& output, int& scanned) const override;
+    QByteArray commandBytes(CmdQueueItem* cmd) override;
+    bool canPipeline(const CmdQueueItem* cmd) const override;
+    int findPipeMarker(const QByteArray& output, uint tag,
+		       int& consumed, int& scanned) const override;
     void parseMarker(CmdQueueItem* cmd);
 };
 
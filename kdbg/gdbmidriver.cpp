@@ -0,0 +1,854 @@
+/*
+ * Copyright Johannes Sixt
+ * This file is licensed under the GNU General Public License Version 2.
+ * See the file COPYING in the toplevel directory of the source directory.
+ */
+
+#include "gdbmidriver.h"
+#include "exprwnd.h"
+#include <QList>
+#include <QRegExp>
+#include <ctype.h>
+#include <string.h>			/* strncmp, strchr */
+#include <vector>
+
+#include "mydebug.h"
+
+
+/*
+ * A value of an MI record: either a const (a C string) or a tuple or a
+ * list. Tuples carry the names of their members; lists of results do so,
+ * too, lists of values have empty names.
+ */
+struct MiValue
+{
+    QByteArray value;			/* decoded string of a const */
+    QList<QByteArray> names;		/* member names, parallel to items */
+    std::vector<MiValue> items;		/* members of tuples and lists */
+
+    const MiValue* field(const char* name) const;
+    QByteArray bytes(const char* name) const;
+    QString text(const char* name) const { return QString::fromUtf8(bytes(name)); }
+};
+
+const MiValue* MiValue::field(const char* name) const
+{
+    for (int i = 0; i < names.size(); i++) {
+	if (names[i] == name)
+	    return &items[i];
+    }
+    return 0;
+}
+
+QByteArray MiValue::bytes(const char* name) const
+{
+    const MiValue* v = field(name);
+    return v == 0 ? QByteArray() : v->value;
+}
+
+/*
+ * Decodes a C string and appends it to out. p points to the opening
+ * quote; on return it points past the closing quote.
+ */
+static bool parseMiConst(const char*& p, QByteArray& out)
+{
+    if (*p != '"')
+	return false;
+    p++;
+    while (*p != '"') {
+	if (*p == '\0')
+	    return false;
+	if (*p != '\\') {
+	    out += *p++;
+	    continue;
+	}
+	p++;
+	switch (*p) {
+	case 'n': out += '\n'; p++; break;
+	case 't': out += '\t'; p++; break;
+	case 'r': out += '\r'; p++; break;
+	case 'e': out += '\033'; p++; break;
+	case 'a': out += '\a'; p++; break;
+	case 'b': out += '\b'; p++; break;
+	case 'f': out += '\f'; p++; break;
+	case 'v': out += '\v'; p++; break;
+	case '\0':
+	    return false;
+	default:
+	    if (*p >= '0' && *p <= '7') {
+		// up to three octal digits
+		int c = 0;
+		for (int i = 0; i < 3 && *p >= '0' && *p <= '7'; i++)
+		    c = c*8 + *p++ - '0';
+		out += char(c);
+	    } else {
+		out += *p++;
+	    }
+	}
+    }
+    p++;				/* skip closing quote */
+    return true;
+}
+
+static bool parseMiValue(const char*& p, MiValue& v);
+
+/*
+ * Parses a result (name=value) or a plain value and appends it to parent.
+ */
+static bool parseMiItem(const char*& p, MiValue& parent)
+{
+    QByteArray name;
+    if (*p != '"' && *p != '{' && *p != '[') {
+	const char* start = p;
+	while (*p != '\0' && *p != '=' && *p != '\n')
+	    p++;
+	if (*p != '=')
+	    return false;
+	name = QByteArray(start, p-start);
+	p++;
+    }
+    parent.names.push_back(name);
+    parent.items.push_back(MiValue());
+    return parseMiValue(p, parent.items.back());
+}
+
+static bool parseMiValue(const char*& p, MiValue& v)
+{
+    if (*p == '"')
+	return parseMiConst(p, v.value);
+    if (*p != '{' && *p != '[')
+	return false;
+    char closing = *p == '{' ? '}' : ']';
+    p++;
+    while (*p != closing) {
+	if (!parseMiItem(p, v))
+	    return false;
+	if (*p == ',')
+	    p++;
+	else if (*p != closing)
+	    return false;
+    }
+    p++;
+    return true;
+}
+
+/*
+ * Parses the results that follow the class of a record, p points right
+ * after the class name.
+ */
+static bool parseMiResults(const char* p, MiValue& results)
+{
+    while (*p == ',') {
+	p++;
+	if (!parseMiItem(p, results))
+	    return false;
+    }
+    return true;
+}
+
+/*
+ * Returns the start of the first record in output that begins with prefix
+ * (for example "*stopped"), or 0.
+ */
+static const char* findMiRecord(const char* output, const char* prefix)
+{
+    size_t len = strlen(prefix);
+    for (const char* p = output; p != 0 && *p != '\0'; ) {
+	if (strncmp(p, prefix, len) == 0 &&
+	    (p[len] == ',' || p[len] == '\n' || p[len] == '\0'))
+	{
+	    return p;
+	}
+	p = strchr(p, '\n');
+	if (p != 0)
+	    p++;
+    }
+    return 0;
+}
+
+/*
+ * Looks for the result named name in the ^done records of output.
+ */
+static bool findMiResult(const char* output, const char* name, MiValue& value)
+{
+    for (const char* p = output; p != 0 && *p != '\0'; ) {
+	if (strncmp(p, "^done,", 6) == 0) {
+	    MiValue results;
+	    parseMiResults(p+5, results);
+	    const MiValue* v = results.field(name);
+	    if (v != 0) {
+		value = *v;
+		return true;
+	    }
+	}
+	p = strchr(p, '\n');
+	if (p != 0)
+	    p++;
+    }
+    return false;
+}
+
+/*
+ * Looks for the frame that gdb reports when the program stops or when
+ * another frame or thread is selected.
+ */
+static bool findMiFrame(const char* records, MiValue& frame)
+{
+    static const char* const prefixes[] = {
+	"*stopped", "=thread-selected", "^done"
+    };
+    for (size_t i = 0; i < sizeof(prefixes)/sizeof(prefixes[0]); i++) {
+	const char* rec = findMiRecord(records, prefixes[i]);
+	if (rec == 0)
+	    continue;
+	MiValue results;
+	parseMiResults(rec+strlen(prefixes[i]), results);
+	const MiValue* f = results.field("frame");
+	if (f != 0) {
+	    frame = *f;
+	    return true;
+	}
+    }
+    return false;
+}
+
+/*
+ * Separates the collected output into the decoded console stream, which is
+ * what the CLI parsers expect, and the result and async records, which are
+ * kept verbatim, but without their tokens. The message of an error record
+ * is added to the console output, where the CLI would have printed it.
+ */
+static void splitMiOutput(const QByteArray& output,
+			  QByteArray& console, QByteArray& records)
+{
+    const char* p = output.constData();
+    while (*p != '\0') {
+	const char* end = strchr(p, '\n');
+	if (end == 0)
+	    end = p + strlen(p);
+	// skip the token
+	while (isdigit(*p))
+	    p++;
+	switch (*p) {
+	case '~':
+	    p++;
+	    parseMiConst(p, console);
+	    break;
+	case '^':
+	    if (strncmp(p, "^error,", 7) == 0) {
+		MiValue results;
+		parseMiResults(p+6, results);
+		console += results.bytes("msg");
+		console += '\n';
+	    }
+	    // fall through
+	case '*':
+	case '=':
+	    records.append(p, end-p);
+	    records += '\n';
+	    break;
+	default:
+	    // the log stream, target output, and the prompt
+	    break;
+	}
+	p = *end == '\0' ? end : end+1;
+    }
+}
+
+/*
+ * Removes the lines with the --fullname markers.
+ */
+static void removeMarkers(QByteArray& text)
+{
+    int pos;
+    while ((pos = text.indexOf("\032\032")) >= 0) {
+	int end = text.indexOf('\n', pos);
+	text.remove(pos, end < 0 ? text.length()-pos : end+1-pos);
+    }
+}
+
+/*
+ * Turns the result of -stack-list-variables into the format of "info
+ * locals" followed by "info args", which is what parseLocals() expects.
+ * With --simple-values, structs and arrays come without a value; they are
+ * written like gdb does when "print max-depth" leaves out the members.
+ */
+static QByteArray localsText(const QByteArray& records, const QByteArray& console)
+{
+    MiValue vars;
+    if (!findMiResult(records.constData(), "variables", vars))
+	return console;			/* an error message */
+
+    QByteArray locals, args;
+    for (size_t i = 0; i < vars.items.size(); i++) {
+	const MiValue& v = vars.items[i];
+	QByteArray& text = v.field("arg") != 0  ?  args  :  locals;
+	const MiValue* value = v.field("value");
+	text += v.bytes("name") + " = " + (value != 0 ? value->value : QByteArray("{...}")) + '\n';
+    }
+    if (locals.isEmpty() && args.isEmpty())
+	return "No locals.\nNo arguments.\n";
+    return locals + args;
+}
+
+static void parseMiFrame(const MiValue& frame, FrameInfo& info)
+{
+    info.fileName = frame.text("fullname");
+    if (info.fileName.isEmpty())
+	info.fileName = frame.text("file");
+    QString line = frame.text("line");
+    info.lineNo = line.isEmpty() ? -1 : line.toInt()-1;
+    info.address = frame.text("addr");
+}
+
+/*
+ * Formats a frame like a line of the CLI backtrace.
+ */
+static QString frameText(const MiValue& frame, const MiValue* args)
+{
+    QString text = frame.text("func");
+    if (text.isEmpty())
+	text = "??";
+    if (args != 0) {
+	text += " (";
+	for (size_t i = 0; i < args->items.size(); i++) {
+	    const MiValue& arg = args->items[i];
+	    if (i > 0)
+		text += ", ";
+	    text += arg.text("name") + "=";
+	    // --simple-values omits the values of aggregates
+	    const MiValue* v = arg.field("value");
+	    text += v != 0 ? QString::fromUtf8(v->value) : QString("...");
+	}
+	text += ")";
+    }
+    QString file = frame.text("file");
+    if (!file.isEmpty()) {
+	text += " at " + file + ":" + frame.text("line");
+    } else {
+	QString from = frame.text("from");
+	if (!from.isEmpty())
+	    text += " from " + from;
+    }
+    return text;
+}
+
+
+GdbMiDriver::GdbMiDriver() :
+	GdbDriver(),
+	m_waitStopped(false)
+{
+}
+
+GdbMiDriver::~GdbMiDriver()
+{
+}
+
+
+QString GdbMiDriver::driverName() const
+{
+    return "GDBMI";
+}
+
+QString GdbMiDriver::defaultGdbMi()
+{
+    return
+	"gdb"
+	" --interpreter=mi3"	/* talk the machine interface */
+	" --fullname"		/* to get standard file names from "info line" */
+	" --nx";		/* do not execute initialization files */
+}
+
+QString GdbMiDriver::defaultInvocation() const
+{
+    if (m_defaultCmd.isEmpty()) {
+	return defaultGdbMi();
+    } else {
+	return m_defaultCmd;
+    }
+}
+
+bool GdbMiDriver::startup(QString cmdStr)
+{
+    if (cmdStr.isEmpty())
+	cmdStr = defaultInvocation();
+    // a custom invocation must still select the machine interface
+    if (!cmdStr.contains("--interpreter"))
+	cmdStr += " --interpreter=mi3";
+
+    // bypass GdbDriver::startup(), which initializes a CLI gdb
+    if (!DebuggerDriver::startup(cmdStr))
+	return false;
+
+    static const char miInitialize[] =
+	"-gdb-set confirm off\n"
+	"-gdb-set print static-members off\n"
+	"-gdb-set print asm-demangle on\n"
+	"-gdb-set print thread-events off\n"
+	/*
+	 * We do not want Python pretty printer support, because their
+	 * output is unpredictable, and we cannot parse it.
+	 */
+	"-gdb-set auto-load python off\n"
+	"-gdb-set python print-stack none\n"
+	/*
+	 * Don't assume that program functions invoked from a watch expression
+	 * always succeed.
+	 */
+	"-gdb-set unwindonsignal on\n"
+	// check endianness for memory dumps
+	"show endian\n"
+	// GdbDriver::commandFinished() looks for the version number
+	"-gdb-version\n"
+	;
+
+    executeCmdString(DCinitialize, miInitialize, false);
+
+    return true;
+}
+
+QString GdbMiDriver::makeCmdString(DbgCommand cmd)
+{
+    switch (cmd) {
+    case DCinfolinemain:
+	// there are no user-defined commands in MI mode
+	return "info line main\n";
+    case DCinfolocals:
+	if (m_shallowLocals)
+	    return "-stack-list-variables --simple-values\n";
+	return "-stack-list-variables --all-values\n";
+    case DCinfothreads:
+	return "-thread-info\n";
+    case DCinfobreak:
+	return "-break-list\n";
+    default:
+	return GdbDriver::makeCmdString(cmd);
+    }
+}
+
+QString GdbMiDriver::makeCmdString(DbgCommand cmd, int intArg)
+{
+    switch (cmd) {
+    case DCbt:
+	// the innermost intArg frames
+	return QString::asprintf(
+	    "-stack-list-frames 0 %d\n"
+	    "-stack-list-arguments --simple-values 0 %d\n",
+	    intArg-1, intArg-1);
+    default:
+	return GdbDriver::makeCmdString(cmd, intArg);
+    }
+}
+
+QByteArray GdbMiDriver::commandBytes(CmdQueueItem* cmd)
+{
+    QByteArray str = DebuggerDriver::commandBytes(cmd);
+    if (str.isEmpty())
+	return str;
+
+    /*
+     * Only the last line of a multi-line command is tagged. Its result
+     * record comes after those of all other lines, and findPrompt() waits
+     * for it. Pipelined commands use their tag as the token.
+     */
+    QByteArray token;
+    if (cmd->m_pipeTag != 0) {
+	token = QByteArray::number(cmd->m_pipeTag);
+    } else {
+	token = QByteArray::number(++m_tagCounter);
+	m_activeToken = token;
+    }
+    int lastLine = str.length() > 1 ? str.lastIndexOf('\n', str.length()-2) + 1 : 0;
+    str.insert(lastLine, token);
+    return str;
+}
+
+/*
+ * The command is complete when its result record has arrived. We do not
+ * look for the "(gdb)" prompt: gdb prints it also after asynchronous
+ * records. Returns the offset after the result record or -1.
+ *
+ * \a running is set when the result record of a command that resumed
+ * the program has been seen; thereafter, \a scanned is where the search
+ * for the "*stopped" record resumes.
+ */
+static int findResultRecord(const QByteArray& output, const QByteArray& token,
+			    int& scanned, bool& running)
+{
+    if (scanned == 0)
+	running = false;		/* new output begins */
+
+    if (!running) {
+	QByteArray tag = token + '^';
+	int pos = scanned-1;
+	do {
+	    pos = output.indexOf(tag, pos+1);
+	    if (pos < 0) {
+		// records begin at the start of a line
+		scanned = output.lastIndexOf('\n') + 1;
+		return -1;
+	    }
+	} while (pos > 0 && output[pos-1] != '\n');
+
+	// if the record is not complete, resume the search here
+	scanned = pos;
+
+	int end = output.indexOf('\n', pos);
+	if (end < 0)
+	    return -1;			/* the record is incomplete */
+
+	if (strncmp(output.constData()+pos+tag.length(), "running", 7) != 0)
+	    return end+1;
+
+	/*
+	 * Commands that resume the program are complete only when it has
+	 * stopped again.
+	 */
+	running = true;
+	scanned = end+1;
+    }
+
+    // scanned is at the start of a line
+    int pos = output.indexOf("\n*stopped", scanned-1);
+    if (pos < 0) {
+	scanned = output.lastIndexOf('\n') + 1;
+	return -1;
+    }
+    int end = output.indexOf('\n', pos+1);
+    if (end < 0) {
+	scanned = pos+1;		/* the record is incomplete */
+	return -1;
+    }
+    return end+1;
+}
+
+int GdbMiDriver::findPrompt(const QByteArray& output, int& scanned) const
+{
+    return findResultRecord(output, m_activeToken, scanned, m_waitStopped);
+}
+
+int GdbMiDriver::findPipeMarker(const QByteArray& output, uint tag,
+				int& consumed, int& scanned) const
+{
+    // the token of the result record is the marker
+    consumed = findResultRecord(output, QByteArray::number(tag), scanned,
+				m_waitStopped);
+    return consumed;
+}
+
+void GdbMiDriver::commandFinished(CmdQueueItem* cmd)
+{
+    QByteArray console, records;
+    splitMiOutput(m_output, console, records);
+
+    // the location where the program stopped, if gdb reports one
+    MiValue frame;
+    bool haveFrame = findMiFrame(records.constData(), frame);
+    if (haveFrame)
+	removeMarkers(console);
+
+    switch (cmd->m_cmd) {
+    case DCbt:
+    case DCinfobreak:
+    case DCinfothreads:
+	// these are parsed from the records
+	m_output = records;
+	break;
+    case DCinfolocals:
+	m_output = localsText(records, console);
+	break;
+    case DCprintBatch:
+	// parsePrintBatch() needs the result records as separators
+	break;
+    case DCattach:
+    case DCrun:
+    case DCcont:
+    case DCstep:
+    case DCstepi:
+    case DCnext:
+    case DCnexti:
+    case DCfinish:
+    case DCuntil:
+	{
+	    // parseProgramStopped() expects the stop record first
+	    m_output = console;
+	    const char* stop = findMiRecord(records.constData(), "*stopped");
+	    if (stop != 0) {
+		const char* end = strchr(stop, '\n');
+		m_output.prepend(QByteArray(stop, end+1-stop));
+	    }
+	}
+	break;
+    default:
+	m_output = console;
+	break;
+    }
+
+    GdbDriver::commandFinished(cmd);
+    if (!cmd->m_committed)
+	return;
+
+    switch (cmd->m_cmd) {
+    case DCinfolinemain:
+    case DCinfoline:
+	if (!console.contains("\032\032"))
+	    activateInfoLine(cmd, console);
+	break;
+    case DCcorefile:
+    case DCframe:
+    case DCattach:
+    case DCrun:
+    case DCcont:
+    case DCstep:
+    case DCstepi:
+    case DCnext:
+    case DCnexti:
+    case DCfinish:
+    case DCuntil:
+	if (haveFrame) {
+	    FrameInfo info;
+	    parseMiFrame(frame, info);
+	    // use the address in cmd if there is one
+	    DbgAddr address = cmd->m_addr;
+	    if (address.isEmpty())
+		address = info.address;
+	    if (!info.fileName.isEmpty())
+		emit activateFileLine(info.fileName, info.lineNo, address);
+	}
+	break;
+    default:;
+    }
+}
+
+/*
+ * gdb does not necessarily print the --fullname marker in MI mode. If it
+ * is missing, the location is taken from the output of "info line".
+ */
+void GdbMiDriver::activateInfoLine(CmdQueueItem* cmd, const QByteArray& console)
+{
+    static QRegExp lineRE("Line (\\d+) of \"([^\"]+)\"[^\\n]* at address (0x[0-9a-fA-F]+)");
+
+    if (lineRE.indexIn(console) < 0)
+	return;
+
+    DbgAddr address = cmd->m_addr;
+    if (address.isEmpty())
+	address = lineRE.cap(3);
+    emit activateFileLine(lineRE.cap(2), lineRE.cap(1).toInt()-1, address);
+}
+
+void GdbMiDriver::parsePrintBatch(const char* output, std::list<ExprValue*>& values)
+{
+    /*
+     * Each print command ends with a result record; the console output
+     * before it is the value.
+     */
+    QByteArray console;
+    const char* p = output;
+    while (*p != '\0') {
+	const char* end = strchr(p, '\n');
+	if (end == 0)
+	    end = p + strlen(p);
+	while (isdigit(*p))
+	    p++;
+	if (*p == '~') {
+	    p++;
+	    parseMiConst(p, console);
+	} else if (*p == '^') {
+	    if (strncmp(p, "^error,", 7) == 0) {
+		MiValue results;
+		parseMiResults(p+6, results);
+		console += results.bytes("msg");
+		console += '\n';
+	    }
+	    values.push_back(parsePrintExpr(console.constData(), true));
+	    console.clear();
+	}
+	p = *end == '\0' ? end : end+1;
+    }
+}
+
+void GdbMiDriver::parseBackTrace(const char* output, std::list<StackFrame>& stack)
+{
+    MiValue frames, args;
+    if (!findMiResult(output, "stack", frames))
+	return;
+    findMiResult(output, "stack-args", args);
+
+    for (size_t i = 0; i < frames.items.size(); i++) {
+	const MiValue& frame = frames.items[i];
+	// the arguments are listed in the same order as the frames
+	const MiValue* frameArgs = 0;
+	if (i < args.items.size())
+	    frameArgs = args.items[i].field("args");
+
+	stack.push_back(StackFrame());
+	StackFrame* frm = &stack.back();
+	frm->frameNo = frame.text("level").toInt();
+	parseMiFrame(frame, *frm);
+	frm->var = new ExprValue(frameText(frame, frameArgs), VarTree::NKplain);
+    }
+}
+
+static QString breakLocation(const MiValue& loc)
+{
+    // like "info breakpoints": "in main at test.cpp:12"
+    QString text;
+    QString func = loc.text("func");
+    if (!func.isEmpty())
+	text = "in " + func;
+    QString file = loc.text("file");
+    if (!file.isEmpty()) {
+	if (!text.isEmpty())
+	    text += " ";
+	text += "at " + file + ":" + loc.text("line");
+    }
+    return text;
+}
+
+static void setBreakLocation(Breakpoint& bp, const MiValue& loc)
+{
+    QString addr = loc.text("addr");
+    if (addr.startsWith("0x"))		/* not <PENDING> or <MULTIPLE> */
+	bp.address = addr;
+    bp.location = breakLocation(loc);
+
+    QString file = loc.text("fullname");
+    if (file.isEmpty())
+	file = loc.text("file");
+    if (!file.isEmpty()) {
+	bp.fileName = file;
+	bp.lineNo = loc.text("line").toInt()-1;
+    }
+}
+
+bool GdbMiDriver::parseBreakList(const char* output, std::list<Breakpoint>& brks)
+{
+    MiValue table;
+    if (!findMiResult(output, "BreakpointTable", table))
+	return false;
+    const MiValue* body = table.field("body");
+    if (body == 0)
+	return false;
+
+    for (size_t i = 0; i < body->items.size(); i++) {
+	const MiValue& b = body->items[i];
+	QString number = b.text("number");
+
+	/*
+	 * MI2 lists the locations of a <MULTIPLE> breakpoint as separate
+	 * entries numbered 1.1, 1.2, ...; MI3 puts them into the member
+	 * "locations" of the breakpoint.
+	 */
+	if (number.contains('.')) {
+	    // fill in the location from the first one
+	    if (!brks.empty() && brks.back().location.isEmpty())
+		setBreakLocation(brks.back(), b);
+	    continue;
+	}
+
+	Breakpoint bp;
+	bp.id = number.toInt();
+	if (b.text("type").contains("watchpoint"))
+	    bp.type = Breakpoint::watchpoint;
+	bp.temporary = b.text("disp") == "del";
+	bp.enabled = b.text("enabled") == "y";
+	bp.condition = b.text("cond");
+	bp.ignoreCount = b.text("ignore").toInt();
+	bp.hitCount = b.text("times").toInt();
+
+	if (bp.type == Breakpoint::watchpoint) {
+	    bp.location = b.text("what");
+	} else {
+	    const MiValue* locs = b.field("locations");
+	    if (locs != 0 && !locs->items.empty())
+		setBreakLocation(bp, locs->items.front());
+	    else
+		setBreakLocation(bp, b);
+	    // pending breakpoints have only the location the user typed
+	    if (bp.location.isEmpty())
+		bp.location = b.text("original-location");
+	}
+	brks.push_back(bp);
+    }
+    return true;
+}
+
+std::list<ThreadInfo> GdbMiDriver::parseThreadList(const char* output)
+{
+    std::list<ThreadInfo> threads;
+
+    const char* rec = findMiRecord(output, "^done");
+    if (rec == 0)
+	return threads;
+    MiValue results;
+    parseMiResults(rec+5, results);
+    const MiValue* list = results.field("threads");
+    if (list == 0)
+	return threads;
+    QByteArray current = results.bytes("current-thread-id");
+
+    for (size_t i = 0; i < list->items.size(); i++) {
+	const MiValue& t = list->items[i];
+	ThreadInfo thr;
+	thr.id = t.text("id").toInt();
+	thr.hasFocus = t.bytes("id") == current;
+	// like the Target Id column of "info threads"
+	thr.threadName = t.text("target-id");
+	QString name = t.text("name");
+	if (!name.isEmpty())
+	    thr.threadName += " \"" + name + "\"";
+
+	const MiValue* frame = t.field("frame");
+	if (frame != 0) {
+	    parseMiFrame(*frame, thr);
+	    thr.function = frameText(*frame, frame->field("args"));
+	} else {
+	    // running threads have no frame
+	    thr.function = "[No stack]";
+	    thr.lineNo = -1;
+	}
+	threads.push_back(thr);
+    }
+    return threads;
+}
+
+uint GdbMiDriver::parseProgramStopped(const char* output, bool haveCoreFile,
+				      QString& message)
+{
+    // commandFinished() puts the stop record in front of the console output
+    if (strncmp(output, "*stopped", 8) != 0)
+	return GdbDriver::parseProgramStopped(output, haveCoreFile, message);
+
+    MiValue stop;
+    parseMiResults(output+8, stop);
+    QString reason = stop.text("reason");
+
+    uint flags = SFprogramActive;
+    message = QString();
+    if (reason == "breakpoint-hit") {
+	flags |= SFrefreshBreak;
+    } else if (reason == "signal-received") {
+	message = "Program received signal " + stop.text("signal-name") +
+		", " + stop.text("signal-meaning");
+    } else if (reason == "exited-normally") {
+	flags &= ~SFprogramActive;
+	message = "Program exited normally";
+    } else if (reason == "exited") {
+	flags &= ~SFprogramActive;
+	message = "Program exited with code " + stop.text("exit-code");
+    } else if (reason == "exited-signalled") {
+	flags &= ~SFprogramActive;
+	message = "Program terminated with signal " + stop.text("signal-name") +
+		", " + stop.text("signal-meaning");
+    }
+
+    // the console output tells whether the executable was re-read
+    if (strstr(output, "re-reading symbols.") != 0)
+	flags |= SFrefreshSource;
+
+    // see GdbDriver::parseProgramStopped()
+    flags |= SFrefreshThreads;
+
+    return flags;
+}
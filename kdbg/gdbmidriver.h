@@ -0,0 +1,61 @@
+/*
+ * Copyright Johannes Sixt
+ * This file is licensed under the GNU General Public License Version 2.
+ * See the file COPYING in the toplevel directory of the source directory.
+ */
+
+#ifndef GDBMIDRIVER_H
+#define GDBMIDRIVER_H
+
+#include "gdbdriver.h"
+
+
+/**
+ * This driver talks to gdb using its machine interface (MI).
+ *
+ * Commands whose results gdb can report as structured records (the
+ * backtrace, the breakpoint and thread lists, local variables, and the
+ * reason why the program stopped) are issued as MI commands and are
+ * parsed from the records. All other commands are sent as CLI commands,
+ * which gdb accepts in MI mode as well; their console output is decoded
+ * and handed to the parsers inherited from GdbDriver.
+ *
+ * Every command is tagged with a token, so that its result record can be
+ * identified reliably, even if gdb emits asynchronous records in between.
+ * The token also tells apart the results of pipelined commands, hence, no
+ * echo markers are needed.
+ */
+class GdbMiDriver : public GdbDriver
+{
+    Q_OBJECT
+public:
+    GdbMiDriver();
+    ~GdbMiDriver();
+
+    QString driverName() const override;
+    QString defaultInvocation() const override;
+    static QString defaultGdbMi();
+    bool startup(QString cmdStr) override;
+    void commandFinished(CmdQueueItem* cmd) override;
+
+    void parsePrintBatch(const char* output, std::list<ExprValue*>& values) override;
+    void parseBackTrace(const char* output, std::list<StackFrame>& stack) override;
+    bool parseBreakList(const char* output, std::list<Breakpoint>& brks) override;
+    std::list<ThreadInfo> parseThreadList(const char* output) override;
+    uint parseProgramStopped(const char* output, bool haveCoreFile,
+				     QString& message) override;
+protected:
+    QByteArray m_activeToken;		/* token of the command sent last */
+    mutable bool m_waitStopped;		/* the program was resumed */
+
+    using GdbDriver::makeCmdString;
+    QString makeCmdString(DbgCommand cmd) override;
+    QString makeCmdString(DbgCommand cmd, int intArg) override;
+    QByteArray commandBytes(CmdQueueItem* cmd) override;
+    int findPrompt(const QByteArray& output, int& scanned) const override;
+    int findPipeMarker(const QByteArray& output, uint tag,
+		       int& consumed, int& scanned) const override;
+    void activateInfoLine(CmdQueueItem* cmd, const QByteArray& console);
+};
+
+#endif // GDBMIDRIVER_H
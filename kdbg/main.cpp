@@ -13,6 +13,7 @@
 #include <QCommandLineOption>
 #include "dbgmainwnd.h"
 #include "typetable.h"
+#include "traceevents.h"
 #include "version.h"
 #include <stdlib.h>			/* getenv(3) */
 #include "mydebug.h"
@@ -66,7 +67,7 @@ int main(int argc, char** argv)
     };
     opt("t", i18n("transcript of conversation with the debugger"), "file");
     opt("r", i18n("remote debugging via <device>"), "device");
-    opt("l", i18n("specify language: C, XSLT"), "language");
+    opt("l", i18n("specify language: C, XSLT, or driver: GDB, GDBMI"), "language");
     opt0("x", i18n("use language XSLT (deprecated)"));
     opt("a", i18n("specify arguments of debugged executable"), "args");
     opt("p", i18n("specify PID of process to debug"), "pid");
@@ -78,6 +79,12 @@ int main(int argc, char** argv)
     /* process standard options */
     aboutData.processCommandLine(&parser);
 
+    // record a trace for chrome://tracing or Perfetto
+    QString traceFile = getenv("KDBG_TRACE_EVENTS");
+    if (!traceFile.isEmpty()) {
+	TraceEvents::start(traceFile);
+    }
+
     DebuggerMainWnd* debugger = new DebuggerMainWnd;
     debugger->setObjectName("mainwindow");
 
@@ -91,6 +98,11 @@ int main(int argc, char** argv)
 	    debugger->restore(1);
 	    restored = true;
 	}
+	// further windows that were opened with File|New Window
+	for (int n = 2; KMainWindow::canBeRestored(n); n++) {
+	    DebuggerMainWnd* wnd = new DebuggerMainWnd;
+	    wnd->restore(n);
+	}
     }
 
     debugger->show();
@@ -114,7 +126,9 @@ int main(int argc, char** argv)
     if (transcript.isEmpty()) {
 	transcript = getenv("KDBG_TRANSCRIPT");
     }
-    debugger->setTranscript(transcript);
+    // the transcript is rotated when it grows larger than this many bytes
+    qint64 transcriptMax = QString(getenv("KDBG_TRANSCRIPT_MAXSIZE")).toLongLong();
+    debugger->setTranscript(transcript, transcriptMax);
 
     QString pid = parser.value("p");
     QString programArgs = parser.value("a");
@@ -145,5 +159,6 @@ int main(int argc, char** argv)
     }
 
     int rc = app.exec();
+    TraceEvents::stop();
     return rc;
 }
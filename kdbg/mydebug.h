@@ -7,6 +7,7 @@
 #include <QDebug>
 #include <assert.h>
 #include "config.h"
+#include "traceevents.h"
 
 #ifdef ASSERT
 #undef ASSERT
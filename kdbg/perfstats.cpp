@@ -0,0 +1,171 @@
+/*
+ * Copyright Johannes Sixt
+ * This file is licensed under the GNU General Public License Version 2.
+ * See the file COPYING in the toplevel directory of the source directory.
+ */
+
+#include "perfstats.h"
+#include "dbgdriver.h"			/* DbgCommand */
+#include <QJsonArray>
+
+
+/*
+ * Must be sorted by the DC* values.
+ */
+static const char* const cmdNames[] = {
+    "initialize", "tty", "executable", "targetremote", "corefile",
+    "attach", "infolinemain", "infolocals", "inforegisters", "examine",
+    "infoline", "infotarget", "disassemble", "setdisassflavor", "setargs",
+    "setenv", "unsetenv", "setoption", "cd", "bt",
+    "run", "cont", "step", "stepi", "next",
+    "nexti", "finish", "until", "kill", "detach",
+    "breaktext", "breakline", "tbreakline", "breakaddr", "tbreakaddr",
+    "watchpoint", "delete", "enable", "disable", "print",
+    "printDeref", "printStruct", "printQStringStruct", "printPopup", "frame",
+    "findType", "infosharedlib", "thread", "infothreads", "infobreak",
+    "condition", "setpc", "ignore", "printWChar", "setvariable",
+    "printBatch",
+};
+static_assert(sizeof(cmdNames)/sizeof(cmdNames[0]) == DCprintBatch+1,
+	      "cmdNames must list all DbgCommand values");
+
+const char* dbgCommandName(int cmd)
+{
+    if (cmd < 0 || cmd > DCprintBatch)
+	return "?";
+    return cmdNames[cmd];
+}
+
+
+PerfCounter::PerfCounter(qint64 u) :
+	unit(u),
+	count(0),
+	total(0),
+	max(0)
+{
+    for (int i = 0; i < numBuckets; i++)
+	buckets[i] = 0;
+}
+
+void PerfCounter::add(qint64 value)
+{
+    if (value < 0)
+	value = 0;
+    count++;
+    total += value;
+    if (value > max)
+	max = value;
+    int i = 0;
+    for (qint64 limit = unit; i < numBuckets-1 && value >= limit; limit *= 2)
+	i++;
+    buckets[i]++;
+}
+
+qint64 PerfCounter::bucketLimit(int i) const
+{
+    return i >= numBuckets-1 ? -1 : unit << i;
+}
+
+QJsonObject PerfCounter::toJson() const
+{
+    QJsonArray hist;
+    for (int i = 0; i < numBuckets; i++)
+	hist.append(buckets[i]);
+    QJsonObject o;
+    o["count"] = count;
+    o["total"] = total;
+    o["max"] = max;
+    o["unit"] = unit;
+    o["histogram"] = hist;
+    return o;
+}
+
+
+PerfStats::PerfStats() :
+	m_cmds(DCprintBatch+1),
+	m_stopStart(-1),
+	m_stopCmdCount(0),
+	m_idleAt(-1),
+	m_stopCommands(1)
+{
+    m_clock.start();
+}
+
+void PerfStats::clear()
+{
+    m_cmds.assign(DCprintBatch+1, CmdPerf());
+    m_stopStart = -1;
+    m_stopCmdCount = 0;
+    m_idleAt = -1;
+    m_stopTime = PerfCounter();
+    m_stopCommands = PerfCounter(1);
+    m_uiTime = PerfCounter();
+}
+
+void PerfStats::addCommand(int cmd, qint64 queued, qint64 sent, qint64 received,
+			   qint64 parsed, int bytes, bool fromCache)
+{
+    if (cmd < 0 || cmd >= int(m_cmds.size()))
+	return;
+    CmdPerf& p = m_cmds[cmd];
+    p.queue.add(sent - queued);
+    p.debugger.add(received - sent);
+    p.parse.add(parsed - received);
+    p.bytes += bytes;
+    if (fromCache)
+	p.fromCache++;
+    m_stopCmdCount++;
+}
+
+void PerfStats::beginStop()
+{
+    m_stopStart = now();
+    m_stopCmdCount = 0;
+}
+
+bool PerfStats::endStop()
+{
+    if (m_stopStart < 0)
+	return false;
+    m_idleAt = now();
+    m_stopTime.add(m_idleAt - m_stopStart);
+    m_stopCommands.add(m_stopCmdCount);
+    m_stopStart = -1;
+    return true;
+}
+
+void PerfStats::uiUpdated()
+{
+    if (m_idleAt < 0)
+	return;
+    m_uiTime.add(now() - m_idleAt);
+    m_idleAt = -1;
+}
+
+QJsonObject PerfStats::toJson() const
+{
+    QJsonObject cmds;
+    for (int i = 0; i < int(m_cmds.size()); i++)
+    {
+	const CmdPerf& p = m_cmds[i];
+	if (p.queue.count == 0)
+	    continue;
+	QJsonObject o;
+	o["queue"] = p.queue.toJson();
+	o["debugger"] = p.debugger.toJson();
+	o["parse"] = p.parse.toJson();
+	o["bytes"] = p.bytes;
+	o["fromCache"] = p.fromCache;
+	cmds[dbgCommandName(i)] = o;
+    }
+    QJsonObject stops;
+    stops["time"] = m_stopTime.toJson();
+    stops["commands"] = m_stopCommands.toJson();
+    stops["uiUpdate"] = m_uiTime.toJson();
+
+    QJsonObject result;
+    result["timeUnit"] = QLatin1String("us");
+    result["commands"] = cmds;
+    result["stops"] = stops;
+    return result;
+}
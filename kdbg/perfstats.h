@@ -0,0 +1,105 @@
+/*
+ * Copyright Johannes Sixt
+ * This file is licensed under the GNU General Public License Version 2.
+ * See the file COPYING in the toplevel directory of the source directory.
+ */
+
+#ifndef PERFSTATS_H
+#define PERFSTATS_H
+
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <vector>
+
+
+/**
+ * Counts values and sorts them into a histogram. Bucket 0 receives values
+ * below \a unit, and every following bucket is twice as wide as the one
+ * before; the last bucket receives all larger values.
+ */
+struct PerfCounter
+{
+    enum { numBuckets = 12 };
+    PerfCounter(qint64 unit = 100);
+    void add(qint64 value);
+    qint64 average() const { return count == 0 ? 0 : total / count; }
+    /**
+     * Returns the upper limit of bucket \a i; -1 for the last bucket.
+     */
+    qint64 bucketLimit(int i) const;
+    QJsonObject toJson() const;
+
+    qint64 unit;
+    int count;
+    qint64 total;
+    qint64 max;
+    int buckets[numBuckets];
+};
+
+/**
+ * The numbers that are collected for one kind of command. Times are in
+ * microseconds.
+ */
+struct CmdPerf
+{
+    PerfCounter queue;			/* from enqueued until sent */
+    PerfCounter debugger;		/* from sent until the prompt */
+    PerfCounter parse;			/* handling of the output */
+    qint64 bytes;			/* output received */
+    int fromCache;			/* answered without the debugger */
+    CmdPerf() : bytes(0), fromCache(0) { }
+};
+
+/**
+ * Collects timings of the commands of a debugger driver and of what
+ * happens after the program stopped.
+ *
+ * A stop begins when the program stops and ends when the debugger becomes
+ * idle after all views were updated. The UI update is the time from the
+ * end of a stop until the event loop has processed the pending events,
+ * most notably the repaints.
+ */
+class PerfStats
+{
+public:
+    PerfStats();
+
+    /**
+     * Returns the microseconds since the statistics were started.
+     */
+    qint64 now() const { return m_clock.nsecsElapsed() / 1000; }
+    void clear();
+
+    void addCommand(int cmd, qint64 queued, qint64 sent, qint64 received,
+		    qint64 parsed, int bytes, bool fromCache);
+    void beginStop();
+    /**
+     * Returns true if a stop was in progress.
+     */
+    bool endStop();
+    void uiUpdated();
+
+    const std::vector<CmdPerf>& commands() const { return m_cmds; }
+    const PerfCounter& stopTime() const { return m_stopTime; }
+    const PerfCounter& stopCommands() const { return m_stopCommands; }
+    const PerfCounter& uiTime() const { return m_uiTime; }
+
+    QJsonObject toJson() const;
+
+protected:
+    QElapsedTimer m_clock;
+    std::vector<CmdPerf> m_cmds;	/* indexed by DbgCommand */
+    qint64 m_stopStart;			/* -1 if no stop is in progress */
+    int m_stopCmdCount;			/* commands since the stop */
+    qint64 m_idleAt;			/* -1 if no UI update is pending */
+    PerfCounter m_stopTime;
+    PerfCounter m_stopCommands;
+    PerfCounter m_uiTime;
+};
+
+/**
+ * Returns a readable name of the DbgCommand \a cmd.
+ */
+const char* dbgCommandName(int cmd);
+
+#endif // PERFSTATS_H
@@ -0,0 +1,292 @@
+/*
+ * Copyright Johannes Sixt
+ * This file is licensed under the GNU General Public License Version 2.
+ * See the file COPYING in the toplevel directory of the source directory.
+ */
+
+#include "perfwnd.h"
+#include "debugger.h"
+#include "dbgdriver.h"
+#include "traceevents.h"
+#include <QFile>
+#include <QFileDialog>
+#include <QHeaderView>
+#include <QJsonDocument>
+#include <QPainter>
+#include <klocalizedstring.h>		/* i18n */
+#include <kmessagebox.h>
+
+// how often the numbers are refreshed while the window is visible
+static const int refreshInterval = 1000;
+
+enum {
+    COL_CMD, COL_COUNT, COL_QUEUE, COL_DEBUGGER, COL_MAX, COL_PARSE,
+    COL_BYTES, COL_CACHED, NUM_COLS
+};
+
+static QString ms(qint64 us)
+{
+    return QString::number(us / 1000.0, 'f', 1);
+}
+
+
+HistogramView::HistogramView(QWidget* parent) :
+	QWidget(parent)
+{
+    setSizePolicy(QSizePolicy::Preferred, QSizePolicy::Fixed);
+}
+
+void HistogramView::setCounter(const PerfCounter& counter, const QString& title)
+{
+    m_counter = counter;
+    m_title = title;
+    update();
+}
+
+QSize HistogramView::sizeHint() const
+{
+    return QSize(PerfCounter::numBuckets * 30, fontMetrics().height() * 7);
+}
+
+void HistogramView::paintEvent(QPaintEvent*)
+{
+    QPainter p(this);
+    QFontMetrics fm = fontMetrics();
+    int lineH = fm.height();
+    p.drawText(0, 0, width(), lineH, Qt::AlignLeft, m_title);
+
+    int top = lineH + 2;
+    int bottom = height() - lineH - 2;
+    int barW = width() / PerfCounter::numBuckets;
+    int largest = 0;
+    for (int i = 0; i < PerfCounter::numBuckets; i++)
+	largest = qMax(largest, m_counter.buckets[i]);
+
+    for (int i = 0; i < PerfCounter::numBuckets; i++)
+    {
+	int x = i * barW;
+	if (largest > 0 && m_counter.buckets[i] > 0) {
+	    int h = qMax(1, (bottom - top) * m_counter.buckets[i] / largest);
+	    p.fillRect(x + 1, bottom - h, barW - 2, h, palette().highlight());
+	}
+	// the label is the upper limit of the bucket
+	qint64 limit = m_counter.bucketLimit(i);
+	QString label;
+	if (limit < 0)
+	    label = "+";
+	else if (m_counter.unit == 1)
+	    label = QString::number(limit);
+	else
+	    label = QString::number(limit / 1000.0, 'g', 3);
+	p.drawText(x, bottom + 2, barW, lineH, Qt::AlignHCenter, label);
+    }
+}
+
+
+PerfWindow::PerfWindow(QWidget* parent) :
+	QWidget(parent),
+	m_debugger(0),
+	m_summary(this),
+	m_commands(this),
+	m_histogram(this),
+	m_reset(i18n("&Reset"), this),
+	m_dump(i18n("&Save as JSON..."), this),
+	m_trace(i18n("Record &Trace..."), this),
+	m_layout(QBoxLayout::TopToBottom, this),
+	m_buttons(QBoxLayout::LeftToRight)
+{
+    m_summary.setWordWrap(true);
+
+    QStringList headers;
+    headers << i18n("Command") << i18n("Count")
+	    << i18n("Queue ms") << i18n("Debugger ms") << i18n("Max ms")
+	    << i18n("Parse ms") << i18n("Output KB") << i18n("Cached");
+    m_commands.setColumnCount(NUM_COLS);
+    m_commands.setHeaderLabels(headers);
+    m_commands.setRootIsDecorated(false);
+    m_commands.setAllColumnsShowFocus(true);
+    m_commands.setSortingEnabled(true);
+    m_commands.sortByColumn(COL_DEBUGGER, Qt::DescendingOrder);
+    m_commands.header()->setSectionResizeMode(QHeaderView::ResizeToContents);
+
+    // a trace may have been started from the command line
+    m_trace.setCheckable(true);
+    m_trace.setChecked(TraceEvents::isEnabled());
+
+    m_buttons.addWidget(&m_trace);
+    m_buttons.addStretch(10);
+    m_buttons.addWidget(&m_reset);
+    m_buttons.addWidget(&m_dump);
+
+    m_layout.setSpacing(2);
+    m_layout.addWidget(&m_summary, 0);
+    m_layout.addWidget(&m_commands, 10);
+    m_layout.addWidget(&m_histogram, 0);
+    m_layout.addLayout(&m_buttons);
+    m_layout.activate();
+
+    m_refreshTimer.setInterval(refreshInterval);
+    connect(&m_refreshTimer, SIGNAL(timeout()), SLOT(refresh()));
+    connect(&m_commands, SIGNAL(itemSelectionChanged()), SLOT(updateHistogram()));
+    connect(&m_reset, SIGNAL(clicked()), SLOT(slotReset()));
+    connect(&m_dump, SIGNAL(clicked()), SLOT(slotDumpJson()));
+    connect(&m_trace, SIGNAL(clicked(bool)), SLOT(slotTrace(bool)));
+}
+
+PerfWindow::~PerfWindow()
+{
+}
+
+PerfStats* PerfWindow::stats() const
+{
+    if (m_debugger == 0 || m_debugger->driver() == 0)
+	return 0;
+    return &m_debugger->driver()->perfStats();
+}
+
+void PerfWindow::showEvent(QShowEvent* ev)
+{
+    QWidget::showEvent(ev);
+    refresh();
+    m_refreshTimer.start();
+}
+
+void PerfWindow::hideEvent(QHideEvent* ev)
+{
+    m_refreshTimer.stop();
+    QWidget::hideEvent(ev);
+}
+
+void PerfWindow::refresh()
+{
+    // the trace may have been switched in a different window
+    m_trace.setChecked(TraceEvents::isEnabled());
+
+    PerfStats* perf = stats();
+    if (perf == 0) {
+	m_summary.setText(i18n("No debugger is running."));
+	m_commands.clear();
+	updateHistogram();
+	return;
+    }
+
+    DebuggerDriver* d = m_debugger->driver();
+    const PerfCounter& stopCmds = perf->stopCommands();
+    m_summary.setText(i18n("Queued: %1 high, %2 low priority; %3 in flight\n"
+			   "Stops: %4, on average %5 ms and %6 commands; UI update %7 ms",
+			   d->hipriQueueDepth(), d->lopriQueueDepth(),
+			   d->commandsInFlight(), stopCmds.count,
+			   ms(perf->stopTime().average()),
+			   QString::number(stopCmds.count == 0 ? 0.0 :
+					   double(stopCmds.total) / stopCmds.count, 'f', 1),
+			   ms(perf->uiTime().average())));
+
+    // find the rows that exist already
+    std::vector<QTreeWidgetItem*> rows(perf->commands().size(), 0);
+    for (int i = 0; i < m_commands.topLevelItemCount(); i++) {
+	QTreeWidgetItem* item = m_commands.topLevelItem(i);
+	int cmd = item->data(COL_CMD, Qt::UserRole).toInt();
+	if (cmd >= 0 && cmd < int(rows.size()))
+	    rows[cmd] = item;
+    }
+
+    m_commands.setSortingEnabled(false);
+    for (int cmd = 0; cmd < int(rows.size()); cmd++)
+    {
+	const CmdPerf& p = perf->commands()[cmd];
+	QTreeWidgetItem* item = rows[cmd];
+	if (p.queue.count == 0) {
+	    delete item;
+	    continue;
+	}
+	if (item == 0) {
+	    item = new QTreeWidgetItem(&m_commands);
+	    item->setText(COL_CMD, dbgCommandName(cmd));
+	    item->setData(COL_CMD, Qt::UserRole, cmd);
+	    for (int c = COL_COUNT; c < NUM_COLS; c++)
+		item->setTextAlignment(c, Qt::AlignRight);
+	}
+	// numbers are stored as such so that the columns sort correctly
+	item->setData(COL_COUNT, Qt::DisplayRole, p.queue.count);
+	item->setData(COL_QUEUE, Qt::DisplayRole, ms(p.queue.average()).toDouble());
+	item->setData(COL_DEBUGGER, Qt::DisplayRole, ms(p.debugger.average()).toDouble());
+	item->setData(COL_MAX, Qt::DisplayRole, ms(p.debugger.max).toDouble());
+	item->setData(COL_PARSE, Qt::DisplayRole, ms(p.parse.average()).toDouble());
+	item->setData(COL_BYTES, Qt::DisplayRole, (p.bytes + 1023) / 1024);
+	item->setData(COL_CACHED, Qt::DisplayRole, p.fromCache);
+    }
+    m_commands.setSortingEnabled(true);
+    updateHistogram();
+}
+
+void PerfWindow::updateHistogram()
+{
+    PerfStats* perf = stats();
+    if (perf == 0) {
+	m_histogram.setCounter(PerfCounter(), QString());
+	return;
+    }
+    QTreeWidgetItem* item = m_commands.currentItem();
+    if (item == 0 || !item->isSelected()) {
+	m_histogram.setCounter(perf->stopTime(),
+			       i18n("Time per stop (ms):"));
+    } else {
+	int cmd = item->data(COL_CMD, Qt::UserRole).toInt();
+	m_histogram.setCounter(perf->commands()[cmd].debugger,
+			       i18n("Debugger time of %1 (ms):", item->text(COL_CMD)));
+    }
+}
+
+void PerfWindow::slotReset()
+{
+    PerfStats* perf = stats();
+    if (perf != 0) {
+	perf->clear();
+	m_commands.clear();
+	refresh();
+    }
+}
+
+void PerfWindow::slotDumpJson()
+{
+    PerfStats* perf = stats();
+    if (perf == 0)
+	return;
+
+    QString fileName = QFileDialog::getSaveFileName(this,
+			i18n("Save Performance Data"), QString(),
+			i18n("JSON files (*.json)"));
+    if (fileName.isEmpty())
+	return;
+
+    QJsonObject data = perf->toJson();
+    data["driver"] = m_debugger->driver()->driverName();
+    QFile f(fileName);
+    if (!f.open(QIODevice::WriteOnly) ||
+	f.write(QJsonDocument(data).toJson()) < 0)
+    {
+	KMessageBox::sorry(this, i18n("Cannot write %1.", fileName));
+    }
+}
+
+/*
+ * The trace records the commands and view updates of all debugger windows.
+ */
+void PerfWindow::slotTrace(bool on)
+{
+    if (!on) {
+	TraceEvents::stop();
+	return;
+    }
+    QString fileName = QFileDialog::getSaveFileName(this,
+			i18n("Record Trace"), QString(),
+			i18n("Trace files (*.json)"));
+    if (fileName.isEmpty()) {
+	m_trace.setChecked(false);
+	return;
+    }
+    if (!TraceEvents::start(fileName)) {
+	m_trace.setChecked(false);
+	KMessageBox::sorry(this, i18n("Cannot write %1.", fileName));
+    }
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright Johannes Sixt
+ * This file is licensed under the GNU General Public License Version 2.
+ * See the file COPYING in the toplevel directory of the source directory.
+ */
+
+#ifndef PERFWND_H
+#define PERFWND_H
+
+#include <QBoxLayout>
+#include <QLabel>
+#include <QPushButton>
+#include <QTimer>
+#include <QTreeWidget>
+#include "perfstats.h"
+
+class KDebugger;
+
+
+/**
+ * Draws the histogram of a PerfCounter as bars.
+ */
+class HistogramView : public QWidget
+{
+public:
+    HistogramView(QWidget* parent);
+
+    void setCounter(const PerfCounter& counter, const QString& title);
+    QSize sizeHint() const override;
+
+protected:
+    PerfCounter m_counter;
+    QString m_title;
+    void paintEvent(QPaintEvent*) override;
+};
+
+
+/**
+ * Shows the numbers that the debugger driver collects about its commands.
+ */
+class PerfWindow : public QWidget
+{
+    Q_OBJECT
+public:
+    PerfWindow(QWidget* parent);
+    ~PerfWindow();
+
+    void setDebugger(KDebugger* deb) { m_debugger = deb; }
+
+protected:
+    KDebugger* m_debugger;
+    QLabel m_summary;
+    QTreeWidget m_commands;
+    HistogramView m_histogram;
+    QPushButton m_reset;
+    QPushButton m_dump;
+    QPushButton m_trace;
+    QBoxLayout m_layout;
+    QBoxLayout m_buttons;
+    QTimer m_refreshTimer;
+
+    PerfStats* stats() const;
+    void showEvent(QShowEvent* ev) override;
+    void hideEvent(QHideEvent* ev) override;
+
+protected slots:
+    void refresh();
+    void updateHistogram();
+    void slotReset();
+    void slotDumpJson();
+    void slotTrace(bool on);
+};
+
+#endif // PERFWND_H
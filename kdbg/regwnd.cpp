@@ -14,6 +14,7 @@
 #include <QHeaderView>
 #include <QContextMenuEvent>
 #include <stdlib.h>			/* strtoul */
+#include "traceevents.h"
 
 /** 
  * Register display modes
@@ -501,6 +502,7 @@ void RegisterView::updateGroupVisibility()
 
 void RegisterView::updateRegisters(const std::list<RegisterInfo>& regs)
 {
+    TRACE_SPAN("RegisterView::updateRegisters");
     setUpdatesEnabled(false);
 
     // mark all items as 'not found'
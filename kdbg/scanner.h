@@ -0,0 +1,94 @@
+/*
+ * Copyright Johannes Sixt
+ * This file is licensed under the GNU General Public License Version 2.
+ * See the file COPYING in the toplevel directory of the source directory.
+ */
+
+#ifndef SCANNER_H
+#define SCANNER_H
+
+#include <stdint.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/*
+ * The parsers spend most of their time looking for the next character
+ * that means something to them, like a brace or a quote. scanFor()
+ * examines 16 or 32 characters at a time where the CPU allows it.
+ *
+ * The vector code reads aligned blocks. Such a read never crosses a page
+ * boundary, so it cannot fault even if it reaches beyond the end of the
+ * string.
+ */
+
+/**
+ * Returns a pointer to the first of the characters \a a, \a b, \a c, or
+ * \a d at or after \a p, or to the terminating zero.
+ */
+inline const char* scanFor(const char* p, char a, char b, char c, char d)
+{
+#if defined(__AVX2__) || defined(__SSE2__)
+#if defined(__AVX2__)
+    const int blockSize = 32;
+#else
+    const int blockSize = 16;
+#endif
+    // the characters before the first aligned block
+    for (; (uintptr_t(p) & (blockSize-1)) != 0; p++) {
+	char ch = *p;
+	if (ch == a || ch == b || ch == c || ch == d || ch == '\0')
+	    return p;
+    }
+#if defined(__AVX2__)
+    const __m256i va = _mm256_set1_epi8(a);
+    const __m256i vb = _mm256_set1_epi8(b);
+    const __m256i vc = _mm256_set1_epi8(c);
+    const __m256i vd = _mm256_set1_epi8(d);
+    const __m256i vz = _mm256_setzero_si256();
+    for (;; p += blockSize) {
+	__m256i x = _mm256_load_si256(reinterpret_cast<const __m256i*>(p));
+	__m256i m = _mm256_or_si256(
+		_mm256_or_si256(_mm256_cmpeq_epi8(x, va), _mm256_cmpeq_epi8(x, vb)),
+		_mm256_or_si256(
+		    _mm256_or_si256(_mm256_cmpeq_epi8(x, vc), _mm256_cmpeq_epi8(x, vd)),
+		    _mm256_cmpeq_epi8(x, vz)));
+	unsigned mask = _mm256_movemask_epi8(m);
+	if (mask != 0)
+	    return p + __builtin_ctz(mask);
+    }
+#else
+    const __m128i va = _mm_set1_epi8(a);
+    const __m128i vb = _mm_set1_epi8(b);
+    const __m128i vc = _mm_set1_epi8(c);
+    const __m128i vd = _mm_set1_epi8(d);
+    const __m128i vz = _mm_setzero_si128();
+    for (;; p += blockSize) {
+	__m128i x = _mm_load_si128(reinterpret_cast<const __m128i*>(p));
+	__m128i m = _mm_or_si128(
+		_mm_or_si128(_mm_cmpeq_epi8(x, va), _mm_cmpeq_epi8(x, vb)),
+		_mm_or_si128(
+		    _mm_or_si128(_mm_cmpeq_epi8(x, vc), _mm_cmpeq_epi8(x, vd)),
+		    _mm_cmpeq_epi8(x, vz)));
+	unsigned mask = _mm_movemask_epi8(m);
+	if (mask != 0)
+	    return p + __builtin_ctz(mask);
+    }
+#endif
+#else
+    for (;; p++) {
+	char ch = *p;
+	if (ch == a || ch == b || ch == c || ch == d || ch == '\0')
+	    return p;
+    }
+#endif
+}
+
+inline const char* scanFor(const char* p, char a, char b)
+{
+    return scanFor(p, a, b, a, b);
+}
+
+#endif // SCANNER_H
@@ -21,6 +21,7 @@
 #include <kxmlguiwindow.h>
 #include <kxmlguifactory.h>
 #include <algorithm>
+#include <map>
 #include "mydebug.h"
 
 
@@ -245,52 +246,39 @@ void SourceWindow::drawLineInfoArea(QPainter* p, QPaintEvent* event)
 
 void SourceWindow::updateLineItems(const KDebugger* dbg)
 {
-    // clear outdated breakpoints
-    for (int i = m_lineItems.size()-1; i >= 0; i--) {
-	if (m_lineItems[i] & liBPany) {
-	    // check if this breakpoint still exists
-	    int line = rowToLine(i);
-	    TRACE(QString::asprintf("checking for bp at %d", line));
-	    KDebugger::BrkptROIterator bp = dbg->breakpointsBegin();
-	    for (; bp != dbg->breakpointsEnd(); ++bp)
-	    {
-		if (bp->lineNo == line &&
-		    fileNameMatches(bp->fileName) &&
-		    lineToRow(line, bp->address) == i)
-		{
-		    // yes it exists; mode is changed below
-		    break;
-		}
-	    }
-	    if (bp == dbg->breakpointsEnd()) {
-		/* doesn't exist anymore, remove it */
-		m_lineItems[i] &= ~liBPany;
-	    }
-	}
+    // the breakpoint flags of the rows, from the breakpoints of this file
+    std::map<int,uchar> bpRows;
+    std::vector<const Breakpoint*> brks = dbg->breakpointsInFile(m_fileName);
+    for (std::vector<const Breakpoint*>::const_iterator b = brks.begin(); b != brks.end(); ++b)
+    {
+	const Breakpoint* bp = *b;
+	TRACE(QString("updating %2:%1").arg(bp->lineNo).arg(bp->fileName));
+	int i = bp->lineNo;
+	if (i < 0 || i >= int(m_sourceCode.size()))
+	    continue;
+	// compute new line item flags for breakpoint
+	uchar flags = bp->enabled ? liBP : liBPdisabled;
+	if (bp->temporary)
+	    flags |= liBPtemporary;
+	if (!bp->condition.isEmpty() || bp->ignoreCount != 0)
+	    flags |= liBPconditional;
+	if (bp->isOrphaned())
+	    flags |= liBPorphan;
+	bpRows[lineToRow(i, bp->address)] = flags;
     }
 
-    // add new breakpoints
-    for (KDebugger::BrkptROIterator bp = dbg->breakpointsBegin(); bp != dbg->breakpointsEnd(); ++bp)
+    // update the rows whose breakpoints changed or went away
+    std::map<int,uchar>::const_iterator r = bpRows.begin();
+    for (int row = 0; row < int(m_lineItems.size()); row++)
     {
-	if (fileNameMatches(bp->fileName)) {
-	    TRACE(QString("updating %2:%1").arg(bp->lineNo).arg(bp->fileName));
-	    int i = bp->lineNo;
-	    if (i < 0 || i >= int(m_sourceCode.size()))
-		continue;
-	    // compute new line item flags for breakpoint
-	    uchar flags = bp->enabled ? liBP : liBPdisabled;
-	    if (bp->temporary)
-		flags |= liBPtemporary;
-	    if (!bp->condition.isEmpty() || bp->ignoreCount != 0)
-		flags |= liBPconditional;
-	    if (bp->isOrphaned())
-		flags |= liBPorphan;
-	    // update if changed
-	    int row = lineToRow(i, bp->address);
-	    if ((m_lineItems[row] & liBPany) != flags) {
-		m_lineItems[row] &= ~liBPany;
-		m_lineItems[row] |= flags;
-	    }
+	uchar flags = 0;
+	if (r != bpRows.end() && r->first == row) {
+	    flags = r->second;
+	    ++r;
+	}
+	if ((m_lineItems[row] & liBPany) != flags) {
+	    m_lineItems[row] &= ~liBPany;
+	    m_lineItems[row] |= flags;
 	}
     }
     m_lineInfoArea->update();
@@ -841,8 +829,15 @@ void SourceWindow::contextMenuEvent(QContextMenuEvent* e)
 	m->exec(e->globalPos());
 }
 
+void SourceWindow::paintEvent(QPaintEvent* e)
+{
+    TRACE_SPAN("SourceWindow::paint");
+    QPlainTextEdit::paintEvent(e);
+}
+
 void LineInfoArea::paintEvent(QPaintEvent* e)
 {
+    TRACE_SPAN("LineInfoArea::paint");
     QPainter p(this);
     static_cast<SourceWindow*>(parent())->drawLineInfoArea(&p, e);
 }
@@ -61,6 +61,7 @@ protected:
     void drawLineInfoArea(QPainter* p, QPaintEvent* event);
     void infoMousePress(QMouseEvent* ev);
     void resizeEvent(QResizeEvent* e) override;
+    void paintEvent(QPaintEvent* e) override;
     void contextMenuEvent(QContextMenuEvent* e) override;
     void keyPressEvent(QKeyEvent* ev) override;
     void changeEvent(QEvent* ev) override;
@@ -16,23 +16,30 @@
 class ThreadEntry : public QTreeWidgetItem, public ThreadInfo
 {
 public:
-    ThreadEntry(QTreeWidget* parent, const ThreadInfo& thread);
-    void setFunction(const QString& func);
-
-    bool m_delete;			/* used for updating the list */
+    ThreadEntry(const ThreadInfo& thread);
+    void update(const ThreadInfo& thread);
 };
 
-ThreadEntry::ThreadEntry(QTreeWidget* parent, const ThreadInfo& thread) :
-	QTreeWidgetItem(parent, QStringList() << thread.threadName << thread.function),
-	ThreadInfo(thread),
-	m_delete(false)
+ThreadEntry::ThreadEntry(const ThreadInfo& thread) :
+	QTreeWidgetItem(QStringList() << thread.threadName << thread.function),
+	ThreadInfo(thread)
 {
 }
 
-void ThreadEntry::setFunction(const QString& func)
+/*
+ * Only the texts that changed are set; each one makes the view repaint
+ * the row.
+ */
+void ThreadEntry::update(const ThreadInfo& thread)
 {
-    function = func;
-    setText(1, function);
+    if (threadName != thread.threadName) {
+	threadName = thread.threadName;
+	setText(0, threadName);
+    }
+    if (function != thread.function) {
+	function = thread.function;
+	setText(1, function);
+    }
 }
 
 
@@ -42,10 +49,13 @@ ThreadList::ThreadList(QWidget* parent) :
     setHeaderLabels(QStringList() << i18n("Thread ID") << i18n("Location"));
     header()->setSectionResizeMode(1, QHeaderView::Interactive);
     setRootIsDecorated(false);
+    // all rows are one line; the view need not measure each of them
+    setUniformRowHeights(true);
 
     // load pixmaps
-    m_focusIcon = KIconLoader::global()->loadIcon("pcinner", KIconLoader::User);
-    makeNoFocusIcon();
+    QPixmap focus = KIconLoader::global()->loadIcon("pcinner", KIconLoader::User);
+    m_focusIcon = QIcon(focus);
+    makeNoFocusIcon(focus);
 
     connect(this, SIGNAL(currentItemChanged(QTreeWidgetItem*, QTreeWidgetItem*)),
 	    this, SLOT(slotCurrentChanged(QTreeWidgetItem*)));
@@ -57,60 +67,53 @@ ThreadList::~ThreadList()
 
 void ThreadList::updateThreads(const std::list<ThreadInfo>& threads)
 {
-    // reset flag in all items
-    for (QTreeWidgetItemIterator i(this); *i; ++i)
-	static_cast<ThreadEntry*>(*i)->m_delete = true;
+    /*
+     * The threads that are still there are moved from m_threads to
+     * current. Those that remain in m_threads have finished.
+     */
+    QHash<int,ThreadEntry*> current;
+    current.reserve(threads.size());
+    QList<QTreeWidgetItem*> added;
 
     for (std::list<ThreadInfo>::const_iterator i = threads.begin(); i != threads.end(); ++i)
     {
-	// look up this thread by id
-	ThreadEntry* te = threadById(i->id);
+	ThreadEntry* te = m_threads.take(i->id);
 	if (te == 0) {
-	    te = new ThreadEntry(this, *i);
+	    te = new ThreadEntry(*i);
+	    te->setIcon(0, i->hasFocus  ?  m_focusIcon  :  m_noFocusIcon);
+	    added.append(te);
 	} else {
-	    te->m_delete = false;
-	    te->setFunction(i->function);
+	    te->update(*i);
+	    // set focus icon
+	    if (te->hasFocus != i->hasFocus) {
+		te->hasFocus = i->hasFocus;
+		te->setIcon(0, i->hasFocus  ?  m_focusIcon  :  m_noFocusIcon);
+	    }
 	}
-	// set focus icon
-	te->hasFocus = i->hasFocus;
-	te->setIcon(0, i->hasFocus  ?  QIcon(m_focusIcon)  :  QIcon(m_noFocusIcon));
+	current.insert(i->id, te);
     }
 
-    // delete all entries that have not been seen
-    for (QTreeWidgetItemIterator i(this); *i;)
-    {
-	ThreadEntry* te = static_cast<ThreadEntry*>(*i);
-	++i;		// step ahead before deleting it ;-)
-	if (te->m_delete) {
-	    delete te;
-	}
-    }
-}
+    qDeleteAll(m_threads);
+    m_threads.swap(current);
 
-ThreadEntry* ThreadList::threadById(int id)
-{
-    for (QTreeWidgetItemIterator i(this); *i; ++i)
-    {
-	ThreadEntry* te = static_cast<ThreadEntry*>(*i);
-	if (te->id == id) {
-	    return te;
-	}
-    }
-    return 0;
+    // new threads are inserted in one go
+    if (!added.isEmpty())
+	addTopLevelItems(added);
 }
 
 /*
- * Creates an icon of the same size as the m_focusIcon, but which is
+ * Creates an icon of the same size as the focus icon, but which is
  * totally transparent.
  */
-void ThreadList::makeNoFocusIcon()
+void ThreadList::makeNoFocusIcon(const QPixmap& focus)
 {
-    m_noFocusIcon = m_focusIcon;
+    QPixmap noFocus = focus;
     {
-	QPainter p(&m_noFocusIcon);
-	p.fillRect(0,0, m_noFocusIcon.width(),m_noFocusIcon.height(), QColor(Qt::white));
+	QPainter p(&noFocus);
+	p.fillRect(0,0, noFocus.width(),noFocus.height(), QColor(Qt::white));
     }
-    m_noFocusIcon.setMask(m_noFocusIcon.createHeuristicMask());
+    noFocus.setMask(noFocus.createHeuristicMask());
+    m_noFocusIcon = QIcon(noFocus);
 }
 
 void ThreadList::slotCurrentChanged(QTreeWidgetItem* newItem)
@@ -8,7 +8,8 @@
 #define THREADLIST_H
 
 #include <QTreeWidget>
-#include <QPixmap>
+#include <QHash>
+#include <QIcon>
 #include <list>
 
 class ThreadInfo;
@@ -29,11 +30,11 @@ signals:
     void setThread(int);
 
 protected:
-    ThreadEntry* threadById(int id);
-    void makeNoFocusIcon();
+    void makeNoFocusIcon(const QPixmap& focus);
 
-    QPixmap m_focusIcon;
-    QPixmap m_noFocusIcon;
+    QIcon m_focusIcon;
+    QIcon m_noFocusIcon;
+    QHash<int,ThreadEntry*> m_threads;	/* the items by gdb's thread number */
 };
 
 #endif // THREADLIST_H
@@ -0,0 +1,142 @@
+/*
+ * Copyright Johannes Sixt
+ * This file is licensed under the GNU General Public License Version 2.
+ * See the file COPYING in the toplevel directory of the source directory.
+ */
+
+#include "traceevents.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QString>
+
+// the events are written when this many bytes have accumulated
+static const int flushSize = 64*1024;
+
+bool TraceEvents::s_enabled = false;
+
+static QFile traceFile;
+static QByteArray traceBuffer;
+static QElapsedTimer traceClock;
+static QByteArray tracePid;
+
+
+bool TraceEvents::start(const QString& fileName)
+{
+    stop();
+    traceFile.setFileName(fileName);
+    if (!traceFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+	return false;
+
+    /*
+     * The closing bracket of the array is optional; a trace remains
+     * readable even if kdbg did not stop it.
+     */
+    traceBuffer = "[\n";
+    tracePid = QByteArray::number(QCoreApplication::applicationPid());
+    traceClock.start();
+    s_enabled = true;
+    return true;
+}
+
+void TraceEvents::stop()
+{
+    if (!s_enabled)
+	return;
+    s_enabled = false;
+    traceBuffer += "{}]\n";
+    traceFile.write(traceBuffer);
+    traceFile.close();
+    traceBuffer.clear();
+}
+
+qint64 TraceEvents::now()
+{
+    return traceClock.nsecsElapsed() / 1000;
+}
+
+static QByteArray quote(const QString& s)
+{
+    QByteArray result = "\"";
+    QByteArray utf8 = s.toUtf8();
+    for (int i = 0; i < utf8.size(); i++) {
+	char c = utf8[i];
+	if (c == '"' || c == '\\') {
+	    result += '\\';
+	    result += c;
+	} else if (uchar(c) < ' ') {
+	    result += QByteArray("\\u00") + QByteArray::number(uchar(c) >> 4, 16) +
+			QByteArray::number(uchar(c) & 15, 16);
+	} else {
+	    result += c;
+	}
+    }
+    result += '"';
+    return result;
+}
+
+/*
+ * Appends an event with the fields that all events have; \a more are
+ * further fields.
+ */
+static void addEvent(const char* name, char phase, qint64 ts,
+		     const QString& arg, const QByteArray& more)
+{
+    traceBuffer += "{\"name\":\"";
+    traceBuffer += name;
+    traceBuffer += "\",\"cat\":\"kdbg\",\"ph\":\"";
+    traceBuffer += phase;
+    traceBuffer += "\",\"ts\":" + QByteArray::number(ts) +
+		   ",\"pid\":" + tracePid + ",\"tid\":1";
+    traceBuffer += more;
+    if (!arg.isEmpty())
+	traceBuffer += ",\"args\":{\"detail\":" + quote(arg) + "}";
+    traceBuffer += "},\n";
+
+    if (traceBuffer.size() >= flushSize) {
+	traceFile.write(traceBuffer);
+	traceFile.flush();
+	traceBuffer.clear();
+    }
+}
+
+static QByteArray asyncId(const void* id)
+{
+    return ",\"id\":\"0x" + QByteArray::number(quintptr(id), 16) + "\"";
+}
+
+void TraceEvents::complete(const char* name, qint64 begin, const QString& arg)
+{
+    if (!s_enabled)
+	return;
+    qint64 end = now();
+    addEvent(name, 'X', begin, arg, ",\"dur\":" + QByteArray::number(end - begin));
+}
+
+void TraceEvents::instant(const char* name, const QString& arg)
+{
+    if (!s_enabled)
+	return;
+    addEvent(name, 'i', now(), arg, ",\"s\":\"t\"");
+}
+
+void TraceEvents::asyncBegin(const char* name, const void* id, const QString& arg)
+{
+    if (!s_enabled)
+	return;
+    addEvent(name, 'b', now(), arg, asyncId(id));
+}
+
+void TraceEvents::asyncEnd(const char* name, const void* id)
+{
+    if (!s_enabled)
+	return;
+    addEvent(name, 'e', now(), QString(), asyncId(id));
+}
+
+
+TraceSpan::~TraceSpan()
+{
+    if (m_begin >= 0)
+	TraceEvents::complete(m_name, m_begin, QString::fromLatin1(m_arg));
+}
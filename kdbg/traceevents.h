@@ -0,0 +1,76 @@
+/*
+ * Copyright Johannes Sixt
+ * This file is licensed under the GNU General Public License Version 2.
+ * See the file COPYING in the toplevel directory of the source directory.
+ */
+
+#ifndef TRACEEVENTS_H
+#define TRACEEVENTS_H
+
+#include <QtGlobal>
+
+class QString;
+
+/**
+ * Writes events in the trace event format of Chrome (chrome://tracing,
+ * Perfetto) so that the timing of commands and view updates can be
+ * inspected in a trace viewer.
+ *
+ * Recording can be switched on and off at any time. While it is off, the
+ * functions return after a test of a flag, so that the calls can remain
+ * in the code. Use the macros below so that the arguments are not even
+ * computed.
+ *
+ * Spans that overlap others, like the time that a command waits in the
+ * queue, are written as async events that are identified by \a id.
+ */
+class TraceEvents
+{
+public:
+    static bool isEnabled() { return s_enabled; }
+    /**
+     * Starts recording to \a fileName. Returns false if the file cannot
+     * be written.
+     */
+    static bool start(const QString& fileName);
+    static void stop();
+
+    /**
+     * Returns the microseconds since the trace was started.
+     */
+    static qint64 now();
+
+    static void complete(const char* name, qint64 begin, const QString& arg);
+    static void instant(const char* name, const QString& arg);
+    static void asyncBegin(const char* name, const void* id, const QString& arg);
+    static void asyncEnd(const char* name, const void* id);
+
+protected:
+    static bool s_enabled;
+};
+
+/**
+ * Records the time from its construction until its destruction.
+ */
+class TraceSpan
+{
+public:
+    TraceSpan(const char* name, const char* arg = 0) :
+	m_name(name), m_arg(arg),
+	m_begin(TraceEvents::isEnabled() ? TraceEvents::now() : -1) { }
+    ~TraceSpan();
+protected:
+    const char* m_name;
+    const char* m_arg;
+    qint64 m_begin;			/* -1 if not recording */
+};
+
+#define TRACE_SPAN(name) TraceSpan traceSpan_(name)
+#define TRACE_INSTANT(name, arg) \
+    do { if (TraceEvents::isEnabled()) TraceEvents::instant(name, arg); } while (0)
+#define TRACE_ASYNC_BEGIN(name, id, arg) \
+    do { if (TraceEvents::isEnabled()) TraceEvents::asyncBegin(name, id, arg); } while (0)
+#define TRACE_ASYNC_END(name, id) \
+    do { if (TraceEvents::isEnabled()) TraceEvents::asyncEnd(name, id); } while (0)
+
+#endif // TRACEEVENTS_H
@@ -0,0 +1,144 @@
+/*
+ * Copyright Johannes Sixt
+ * This file is licensed under the GNU General Public License Version 2.
+ * See the file COPYING in the toplevel directory of the source directory.
+ */
+
+#include "transcript.h"
+#include <QMutexLocker>
+#include <QString>
+
+// the oldest records are dropped when this many bytes are not yet written
+static const int maxPending = 4*1024*1024;
+
+
+Transcript::Transcript() :
+	m_pendingSize(0),
+	m_dropped(0),
+	m_writing(false),
+	m_stop(false),
+	m_open(false),
+	m_atLineStart(true),
+	m_fileAtLineStart(true),
+	m_maxSize(0)
+{
+}
+
+Transcript::~Transcript()
+{
+    if (m_open) {
+	{
+	    QMutexLocker lock(&m_mutex);
+	    m_stop = true;
+	    m_dataAvailable.wakeOne();
+	}
+	// the thread writes the remaining records before it ends
+	wait();
+	m_file.close();
+    }
+}
+
+bool Transcript::open(const QString& fileName, qint64 maxSize)
+{
+    if (m_open)
+	return true;
+
+    m_fileName = fileName;
+    m_maxSize = maxSize;
+    m_file.setFileName(m_fileName);
+    if (!m_file.open(QIODevice::WriteOnly))
+	return false;
+
+    m_open = true;
+    m_clock.start();
+    start(QThread::LowPriority);
+    return true;
+}
+
+void Transcript::write(Record kind, const QByteArray& data)
+{
+    if (!m_open)
+	return;
+
+    static const char kindChar[] = { '>', '<', '=' };
+    qint64 ms = m_clock.elapsed();
+    QByteArray rec = QString::asprintf("%s#### %lld.%03lld %c\n",
+				       m_atLineStart ? "" : "\n",
+				       ms / 1000, ms % 1000,
+				       kindChar[kind]).toLatin1();
+    rec += data;
+    m_atLineStart = data.endsWith('\n');
+
+    QMutexLocker lock(&m_mutex);
+    while (!m_pending.isEmpty() && m_pendingSize + rec.size() > maxPending) {
+	m_dropped += m_pending.first().size();
+	m_pendingSize -= m_pending.first().size();
+	m_pending.removeFirst();
+    }
+    m_pendingSize += rec.size();
+    m_pending.append(rec);
+    m_dataAvailable.wakeOne();
+}
+
+void Transcript::flush()
+{
+    if (!m_open)
+	return;
+
+    QMutexLocker lock(&m_mutex);
+    while (!m_pending.isEmpty() || m_writing)
+	m_dataWritten.wait(&m_mutex);
+}
+
+void Transcript::run()
+{
+    QMutexLocker lock(&m_mutex);
+    for (;;) {
+	while (m_pending.isEmpty() && !m_stop)
+	    m_dataAvailable.wait(&m_mutex);
+	if (m_pending.isEmpty())
+	    break;			/* stopped, and everything is written */
+
+	QList<QByteArray> data;
+	data.swap(m_pending);
+	m_pendingSize = 0;
+	qint64 dropped = m_dropped;
+	m_dropped = 0;
+	m_writing = true;
+	lock.unlock();
+
+	// the dropped records came before the ones that are left
+	if (dropped > 0) {
+	    qint64 ms = m_clock.elapsed();
+	    m_file.write(QString::asprintf("%s#### %lld.%03lld =\n"
+					   "dropped %lld bytes\n",
+					   m_fileAtLineStart ? "" : "\n",
+					   ms / 1000, ms % 1000,
+					   dropped).toLatin1());
+	}
+	for (const QByteArray& rec : data)
+	    m_file.write(rec);
+	m_fileAtLineStart = data.last().endsWith('\n');
+
+	/*
+	 * Hand the data to the OS right away so that as little as possible
+	 * is lost should kdbg crash.
+	 */
+	m_file.flush();
+	if (m_maxSize > 0 && m_file.size() >= m_maxSize)
+	    rotate();
+
+	lock.relock();
+	m_writing = false;
+	m_dataWritten.wakeAll();
+    }
+}
+
+void Transcript::rotate()
+{
+    m_file.close();
+    QString old = m_fileName + ".1";
+    QFile::remove(old);
+    QFile::rename(m_fileName, old);
+    m_file.open(QIODevice::WriteOnly);
+}
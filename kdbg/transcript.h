@@ -0,0 +1,76 @@
+/*
+ * Copyright Johannes Sixt
+ * This file is licensed under the GNU General Public License Version 2.
+ * See the file COPYING in the toplevel directory of the source directory.
+ */
+
+#ifndef TRANSCRIPT_H
+#define TRANSCRIPT_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QByteArray>
+#include <QList>
+
+
+/**
+ * Writes the transcript of the conversation with the debugger.
+ *
+ * The records are handed to a background thread that writes them to the
+ * file, so that a slow file system does not hold up the GUI. Each record
+ * is preceded by a line with the time since the transcript was opened.
+ * The amount of data that waits to be written is bounded; when the bound
+ * is reached, the oldest records are dropped, and a note in the file
+ * tells how much was lost, so that the GUI never waits for the disk.
+ */
+class Transcript : public QThread
+{
+public:
+    enum Record {
+	RCommand,			/* sent to the debugger */
+	ROutput,			/* received from the debugger */
+	RNote				/* written by us */
+    };
+
+    Transcript();
+    ~Transcript();
+
+    /**
+     * Opens the transcript file. If \a maxSize is not zero, the file is
+     * renamed to \a fileName.1 when it grows beyond \a maxSize bytes, and
+     * a new file is begun.
+     */
+    bool open(const QString& fileName, qint64 maxSize);
+    bool isOpen() const { return m_open; }
+    void write(Record kind, const QByteArray& data);
+    /**
+     * Waits until all records have been written to the file.
+     */
+    void flush();
+
+protected:
+    void run() override;
+    void rotate();
+
+    QMutex m_mutex;
+    QWaitCondition m_dataAvailable;	/* wakes the writer thread */
+    QWaitCondition m_dataWritten;	/* wakes waiting callers */
+    QList<QByteArray> m_pending;	/* records not yet written */
+    int m_pendingSize;			/* their total size */
+    qint64 m_dropped;			/* bytes dropped since the last write */
+    bool m_writing;			/* the writer thread is busy */
+    bool m_stop;
+
+    bool m_open;
+    bool m_atLineStart;			/* the last record ended with '\n' */
+    QElapsedTimer m_clock;
+    QFile m_file;			/* used by the writer thread */
+    bool m_fileAtLineStart;		/* ditto */
+    QString m_fileName;
+    qint64 m_maxSize;
+};
+
+#endif // TRANSCRIPT_H
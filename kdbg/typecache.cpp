@@ -0,0 +1,249 @@
+/*
+ * Copyright Johannes Sixt
+ * This file is licensed under the GNU General Public License Version 2.
+ * See the file COPYING in the toplevel directory of the source directory.
+ */
+
+#include "typecache.h"
+#include "typetable.h"
+#include "config.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QTextStream>
+#include <string.h>
+#ifdef HAVE_ELF_H
+#include <elf.h>
+#endif
+#include "mydebug.h"
+
+static const char cacheHeader[] = "# kdbg type cache 1";
+
+
+#ifdef HAVE_ELF_H
+/*
+ * Searches the note sections of an ELF file for the GNU build-id.
+ */
+template<class Ehdr, class Shdr, class Nhdr>
+static QByteArray findBuildId(const uchar* data, qint64 size)
+{
+    const Ehdr* eh = reinterpret_cast<const Ehdr*>(data);
+    if (size < qint64(sizeof(Ehdr)) || eh->e_shentsize != sizeof(Shdr) ||
+	qint64(eh->e_shoff) + qint64(eh->e_shnum) * qint64(sizeof(Shdr)) > size)
+	return QByteArray();
+
+    const Shdr* sh = reinterpret_cast<const Shdr*>(data + eh->e_shoff);
+    for (int i = 0; i < eh->e_shnum; i++)
+    {
+	if (sh[i].sh_type != SHT_NOTE ||
+	    qint64(sh[i].sh_offset) + qint64(sh[i].sh_size) > size)
+	    continue;
+	const uchar* p = data + sh[i].sh_offset;
+	const uchar* end = p + sh[i].sh_size;
+	while (end - p >= qint64(sizeof(Nhdr)))
+	{
+	    const Nhdr* n = reinterpret_cast<const Nhdr*>(p);
+	    const uchar* name = p + sizeof(Nhdr);
+	    const uchar* desc = name + ((n->n_namesz + 3) & ~3U);
+	    const uchar* next = desc + ((n->n_descsz + 3) & ~3U);
+	    if (next > end)
+		break;
+	    if (n->n_type == NT_GNU_BUILD_ID &&
+		n->n_namesz == 4 && memcmp(name, "GNU", 4) == 0)
+	    {
+		return QByteArray(reinterpret_cast<const char*>(desc), n->n_descsz);
+	    }
+	    p = next;
+	}
+    }
+    return QByteArray();
+}
+#endif
+
+static QByteArray readBuildId(const QString& fileName)
+{
+    QByteArray id;
+#ifdef HAVE_ELF_H
+    QFile f(fileName);
+    if (!f.open(QIODevice::ReadOnly))
+	return id;
+    qint64 size = f.size();
+    const uchar* data = f.map(0, size);
+    if (data == 0)
+	return id;
+
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    const uchar hostData = ELFDATA2LSB;
+#else
+    const uchar hostData = ELFDATA2MSB;
+#endif
+    if (size > EI_NIDENT && memcmp(data, ELFMAG, SELFMAG) == 0 &&
+	data[EI_DATA] == hostData)
+    {
+	if (data[EI_CLASS] == ELFCLASS64)
+	    id = findBuildId<Elf64_Ehdr,Elf64_Shdr,Elf64_Nhdr>(data, size);
+	else if (data[EI_CLASS] == ELFCLASS32)
+	    id = findBuildId<Elf32_Ehdr,Elf32_Shdr,Elf32_Nhdr>(data, size);
+    }
+    f.unmap(const_cast<uchar*>(data));
+#else
+    Q_UNUSED(fileName);
+#endif
+    return id;
+}
+
+
+QString cacheNameForExe(const QString& executable)
+{
+    QFileInfo fi(executable);
+    if (!fi.isFile())
+	return QString();
+
+    QByteArray key = readBuildId(fi.absoluteFilePath()).toHex();
+    if (key.isEmpty()) {
+	QCryptographicHash digest(QCryptographicHash::Md5);
+	digest.addData(fi.absoluteFilePath().toUtf8());
+	digest.addData(QByteArray::number(fi.size()));
+	digest.addData(QByteArray::number(fi.lastModified().toMSecsSinceEpoch()));
+	key = digest.result().toHex();
+    }
+    return fi.fileName() + "-" + QString::fromLatin1(key);
+}
+
+
+TypeCache::TypeCache() :
+	m_dirty(false)
+{
+}
+
+void TypeCache::load(const QString& executable)
+{
+    m_types.clear();
+    m_aliases.clear();
+    m_dirty = false;
+    QString name = cacheNameForExe(executable);
+    if (name.isEmpty()) {
+	m_fileName = QString();
+	return;
+    }
+    m_fileName = QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+		+ "/types/" + name;
+
+    QFile f(m_fileName);
+    if (!f.open(QIODevice::ReadOnly))
+	return;
+    QTextStream in(&f);
+    in.setCodec("UTF-8");
+    if (in.readLine() != cacheHeader)
+	return;
+
+    while (!in.atEnd())
+    {
+	QStringList parts = in.readLine().split('\t');
+	if (parts.size() == 4 && parts[0] == "T") {
+	    m_types.insert(parts[1] + '\t' + parts[2], parts[3]);
+	} else if (parts.size() == 3 && parts[0] == "A") {
+	    m_aliases[parts[1]] = parts[2];
+	}
+    }
+    TRACE(QString::asprintf("type cache: %d types, %d aliases from ",
+			    m_types.size(), int(m_aliases.size())) + m_fileName);
+}
+
+void TypeCache::save()
+{
+    if (!m_dirty || m_fileName.isEmpty())
+	return;
+
+    QDir().mkpath(QFileInfo(m_fileName).absolutePath());
+    QSaveFile f(m_fileName);
+    if (!f.open(QIODevice::WriteOnly))
+	return;
+    {
+	QTextStream out(&f);
+	out.setCodec("UTF-8");
+	out << cacheHeader << '\n';
+	for (QHash<QString,QString>::const_iterator i = m_types.begin(); i != m_types.end(); ++i)
+	    out << "T\t" << i.key() << '\t' << i.value() << '\n';
+	for (std::map<QString,QString>::const_iterator i = m_aliases.begin(); i != m_aliases.end(); ++i)
+	    out << "A\t" << i->first << '\t' << i->second << '\n';
+    }
+    if (f.commit())
+	m_dirty = false;
+}
+
+bool TypeCache::findType(const QString& scope, const QString& expr, QString& type) const
+{
+    if (scope.isEmpty())
+	return false;
+    QHash<QString,QString>::const_iterator i = m_types.find(scope + '\t' + expr);
+    if (i == m_types.end())
+	return false;
+    type = *i;
+    return true;
+}
+
+/*
+ * The fields of the cache file are separated by tabs and the records by
+ * line breaks; strings that contain them are not recorded.
+ */
+static bool isStorable(const QString& s)
+{
+    return !s.isEmpty() && !s.contains('\t') && !s.contains('\n');
+}
+
+void TypeCache::addType(const QString& scope, const QString& expr, const QString& type)
+{
+    if (m_fileName.isEmpty() ||
+	!isStorable(scope) || !isStorable(expr) || !isStorable(type))
+	return;
+    QString& t = m_types[scope + '\t' + expr];
+    if (t != type) {
+	t = type;
+	m_dirty = true;
+    }
+}
+
+void TypeCache::removeType(const QString& scope, const QString& expr)
+{
+    if (m_types.remove(scope + '\t' + expr) > 0)
+	m_dirty = true;
+}
+
+void TypeCache::addAlias(const QString& alias, const QString& base)
+{
+    if (m_fileName.isEmpty() || !isStorable(alias) || !isStorable(base))
+	return;
+    QString& b = m_aliases[alias];
+    if (b != base) {
+	b = base;
+	m_dirty = true;
+    }
+}
+
+void TypeCache::registerAliases(ProgramTypeTable& typeTable) const
+{
+    /*
+     * The base class of an alias may itself be an alias; repeat until no
+     * more aliases can be resolved.
+     */
+    bool progress = true;
+    while (progress)
+    {
+	progress = false;
+	for (std::map<QString,QString>::const_iterator i = m_aliases.begin(); i != m_aliases.end(); ++i)
+	{
+	    if (typeTable.lookup(i->first) != 0)
+		continue;		/* known already */
+	    const TypeInfo* info = typeTable.lookup(i->second);
+	    if (info != 0) {
+		typeTable.registerAlias(i->first, info);
+		progress = true;
+	    }
+	}
+    }
+}
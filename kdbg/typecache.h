@@ -0,0 +1,76 @@
+/*
+ * Copyright Johannes Sixt
+ * This file is licensed under the GNU General Public License Version 2.
+ * See the file COPYING in the toplevel directory of the source directory.
+ */
+
+#ifndef TYPECACHE_H
+#define TYPECACHE_H
+
+#include <QHash>
+#include <QString>
+#include <map>
+
+class ProgramTypeTable;
+
+/**
+ * Returns a file name under which information about \a executable can be
+ * cached. The name is derived from the GNU build-id of the executable or,
+ * if it has none, from its path, size and modification time, so that it
+ * changes when the executable is rebuilt. Returns an empty string if the
+ * executable is not a file.
+ */
+QString cacheNameForExe(const QString& executable);
+
+
+/**
+ * Remembers across sessions the types that the debugger reported for
+ * struct values, so that they need not be asked for again.
+ *
+ * The type of an expression is recorded together with the function in
+ * which it was evaluated; as long as the executable is not rebuilt, the
+ * same expression in the same function has the same type. This is not so
+ * if blocks declare variables of the same name; therefore, the caller
+ * removes a type that turns out to be wrong. Aliases that were inferred
+ * from base classes are recorded, too. A rebuilt executable starts with
+ * an empty cache; see cacheNameForExe().
+ */
+class TypeCache
+{
+public:
+    TypeCache();
+
+    /**
+     * Reads the cache that belongs to \a executable. What was known
+     * before is forgotten.
+     */
+    void load(const QString& executable);
+    /**
+     * Writes the cache if it was changed.
+     */
+    void save();
+
+    /**
+     * Looks up the type of \a expr in function \a scope.
+     */
+    bool findType(const QString& scope, const QString& expr, QString& type) const;
+    void addType(const QString& scope, const QString& expr, const QString& type);
+    void removeType(const QString& scope, const QString& expr);
+    /**
+     * Records that \a alias is handled like its base class \a base.
+     */
+    void addAlias(const QString& alias, const QString& base);
+    /**
+     * Registers the recorded aliases whose base class is known in
+     * \a typeTable.
+     */
+    void registerAliases(ProgramTypeTable& typeTable) const;
+
+protected:
+    QString m_fileName;			/* empty if there is no cache */
+    QHash<QString, QString> m_types;	/* scope\texpr -> type */
+    std::map<QString, QString> m_aliases;
+    bool m_dirty;
+};
+
+#endif // TYPECACHE_H
@@ -65,7 +65,7 @@ static XsldbgCmdInfo cmds[] = {
     {DCunsetenv, "unset env %s\n", XsldbgCmdInfo::argString},
     {DCsetoption, "setoption %s %d\n", XsldbgCmdInfo::argStringNum},
     {DCcd, "chdir %s\n", XsldbgCmdInfo::argString},
-    {DCbt, "where\n", XsldbgCmdInfo::argNone},
+    {DCbt, "where\n", XsldbgCmdInfo::argNum}, /* the stack is not deep */
     {DCrun, "run\nsource\n", XsldbgCmdInfo::argNone}, /* Ensure that at the start
 							 of executing XSLT we show the XSLT file */
     {DCcont, "continue\n", XsldbgCmdInfo::argNone},
@@ -102,6 +102,7 @@ static XsldbgCmdInfo cmds[] = {
     {DCignore, "print 'ignore %d %d'\n", XsldbgCmdInfo::argNum2},
     {DCprintWChar, "print 'ignore %s'\n", XsldbgCmdInfo::argString},
     {DCsetvariable, "set %s %s\n", XsldbgCmdInfo::argString2},
+    {DCprintBatch, "print %s\n", XsldbgCmdInfo::argString},
 };
 
 #define NUM_CMDS (int(sizeof(cmds)/sizeof(cmds[0])))
@@ -267,7 +268,7 @@ XsldbgDriver::commandFinished(CmdQueueItem * cmd)
 }
 
 int
-XsldbgDriver::findPrompt(const QByteArray& output) const
+XsldbgDriver::findPrompt(const QByteArray& output, int& scanned) const
 {
     /*
      * If there's a prompt string in the collected output, it must be at
@@ -281,7 +282,14 @@ XsldbgDriver::findPrompt(const QByteArray& output) const
     // There can be text between "(xsldbg) " and the "> " at the end
     // since we do not know what that text is, we accept the former
     // anywhere in the output.
-    return output.indexOf("(xsldbg) ");
+    static const char prompt[] = "(xsldbg) ";
+    int pos = output.indexOf(prompt, scanned);
+    if (pos < 0) {
+	scanned = qMax(0, len - int(sizeof(prompt)-1) + 1);
+    } else {
+	scanned = pos;
+    }
+    return pos;
 }
 
 void
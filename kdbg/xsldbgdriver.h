@@ -77,7 +77,7 @@ class XsldbgDriver:public DebuggerDriver {
     QString makeCmdString(DbgCommand cmd, QString strArg1, QString strArg2) override;
     QString makeCmdString(DbgCommand cmd, int intArg1, int intArg2) override;
     QString makeCmdString(DbgCommand cmd, QString strArg, int intArg1, int intArg2) override;
-    int findPrompt(const QByteArray& output) const override;
+    int findPrompt(const QByteArray& output, int& scanned) const override;
     void parseMarker();
 };
 